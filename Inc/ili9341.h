@@ -8,11 +8,32 @@
 #include "stdbool.h"
 #include "stdint.h"
 #include "stdlib.h"
+#ifndef ILI9341_HOST_BUILD
 #include "stm32f7xx_hal.h"
+#endif
 
 // optionally enable dma by uncommenting the line below
 // #define ILI9341_ENABLE_DMA
 
+// optionally drive CS/DC through cached BSRR addresses and send commands and short parameter blocks by writing the
+// SPI data register directly, instead of going through HAL_GPIO_WritePin and HAL_SPI_Transmit
+// #define ILI9341_FAST_IO
+
+// images are native RGB565 words, uncomment the line below to draw images with the 2 bytes of each pixel swapped, as
+// generated by image_to_array.py --swap
+// #define ILI9341_SWAPPED_IMAGES
+
+// optionally record the bus operations of the displays a trace is attached to (see ili9341_trace.h) by uncommenting
+// the line below
+// #define ILI9341_TRACE
+
+// glyphs are expanded 2 pixels per 32-bit word on the target and with GCC/Clang vector extensions in host builds,
+// with a lookup table elsewhere, uncomment the line below to always use the table
+// #define ILI9341_NO_GLYPH_SIMD
+
+// define ILI9341_HOST_BUILD (e.g. -DILI9341_HOST_BUILD) to build the driver without the STM32 HAL, only transports
+// that do not depend on the HAL (such as the panel simulator in ili9341_sim.h) are available in that case
+
 #define ILI9341_MADCTL_MY 0x80
 #define ILI9341_MADCTL_MX 0x40
 #define ILI9341_MADCTL_MV 0x20
@@ -48,11 +69,275 @@
 
 // Other constants
 #define ILI9341_FILL_RECT_BUFFER_SIZE 512  // x 2 bytes per pixel = 1024 bytes
+#define ILI9341_TEXT_BUFFER_SIZE 512       // x 2 bytes per pixel = 1024 bytes on the stack, rows of a line of text are
+                                           // packed into it when no pixel buffers are attached
+#define ILI9341_MAX_SPI_BUSES 4            // number of SPI buses that can be used at the same time
+#define ILI9341_FAST_IO_MAX_BYTES 16       // longest parameter block sent through the SPI data register with FAST_IO
+#define ILI9341_DIRTY_RECTS 16             // dirty rectangles tracked by a framebuffer, more are merged together
+#define ILI9341_DIRTY_MERGE_PIXELS 64      // unchanged pixels worth resending to save an address window
+#define ILI9341_POLYGON_STACK_EDGES 32     // edges of the polygons ILI9341_FillPolygon fills without caller scratch
+#define ILI9341_STROKE_MITER_LIMIT 4       // miter length over half the thickness above which miter joins are beveled
+#define ILI9341_CLIP_STACK_DEPTH 8         // clip rectangles that can be pushed on a handle
+#define ILI9341_GLYPH_CACHE_LINE 64        // characters of a line of text looked up in the glyph cache, the next ones are
+                                           // expanded each time
+#define ILI9341_READ_CHUNK_PIXELS 32       // x 3 bytes per pixel = 96 bytes, pixels received per read transfer
+#define ILI9341_READ_SPI_MAX_HZ 6600000    // fastest SPI clock of reads, the panel's serial read cycle is 150 ns
+
+// Screenshot stream format, a header followed by chunks of rows, all fields little endian
+#define ILI9341_SCREENSHOT_MAGIC "I9SC"
+#define ILI9341_SCREENSHOT_VERSION 1
+#define ILI9341_SCREENSHOT_HEADER_SIZE 12       // magic, version, width, height, reserved, 16 bits each after the magic
+#define ILI9341_SCREENSHOT_CHUNK_HEADER_SIZE 4  // first row, number of rows, followed by the pixels as RGB565 words
+
+struct __ILI9341_HandleTypeDef;
+struct __ILI9341_TraceTypeDef;
 
 /**
- * @brief ILI9341 handle structure
+ * @brief Function receiving a screenshot stream
+ * @param data Pointer to the next part of the stream
+ * @param size Size of the part in bytes
+ * @param arg Argument given to ILI9341_Screenshot
+ * @return true to continue, false to abort the screenshot
+ */
+typedef bool (*ILI9341_ScreenshotWriteFunc)(const void* data, size_t size, void* arg);
+
+/**
+ * @brief Callback run when an asynchronous transfer of a handle has completed
+ * @note With the HAL DMA transport this runs in interrupt context.
+ */
+typedef void (*ILI9341_TransferCallback)(struct __ILI9341_HandleTypeDef* ili9341, void* arg);
+
+/**
+ * @brief ILI9341 bus transport, the set of operations the driver uses to talk to the display
+ * @note Every operation receives the handle it was called for, backend specific state is reached through the handle
+ * (e.g. spi_handle for the HAL transport, transport_ctx for others). All operations must be provided.
+ */
+typedef struct {
+    /** Assert chip select */
+    void (*select)(struct __ILI9341_HandleTypeDef* ili9341);
+    /** Release chip select */
+    void (*deselect)(struct __ILI9341_HandleTypeDef* ili9341);
+    /** Pulse the hardware reset line */
+    void (*reset)(struct __ILI9341_HandleTypeDef* ili9341);
+    /** Wait for the given number of milliseconds */
+    void (*delay)(struct __ILI9341_HandleTypeDef* ili9341, uint32_t ms);
+    /** Send a command byte with DC low */
+    void (*write_command)(struct __ILI9341_HandleTypeDef* ili9341, uint8_t cmd);
+    /** Send parameter bytes with DC high, the buffer can be reused as soon as the call returns */
+    void (*write_data)(struct __ILI9341_HandleTypeDef* ili9341, const uint8_t* buff, size_t buff_size);
+    /** Send RGB565 pixels in native order with DC high, most significant byte first, the buffer can be reused as soon
+     * as the call returns */
+    void (*write_pixel_data)(struct __ILI9341_HandleTypeDef* ili9341, const uint16_t* pixels, size_t count);
+    /** Start sending RGB565 pixels in native order and return, the buffer must stay untouched until the transfer
+     * completes */
+    void (*write_pixel_data_async)(struct __ILI9341_HandleTypeDef* ili9341, const uint16_t* pixels, size_t count);
+    /** Block until every asynchronous transfer has completed */
+    void (*wait)(struct __ILI9341_HandleTypeDef* ili9341);
+    /** Send the same RGB565 pixel count times with DC high, may return while the last transfer is in flight */
+    void (*write_pixels)(struct __ILI9341_HandleTypeDef* ili9341, uint16_t color, uint32_t count);
+    /** Receive bytes with DC high, after a read command has been written */
+    void (*read_data)(struct __ILI9341_HandleTypeDef* ili9341, uint8_t* buff, size_t buff_size);
+} ILI9341_TransportTypeDef;
+
+#ifndef ILI9341_HOST_BUILD
+/**
+ * @brief Transfer state of an SPI bus, shared by every display on that bus
+ */
+typedef struct {
+    /** SPI handle of the bus, NULL while the slot is unused */
+    SPI_HandleTypeDef* spi_handle;
+    /** Display that started the last transfer, NULL after ILI9341_Init until the returned handle starts one */
+    struct __ILI9341_HandleTypeDef* volatile owner;
+    /** A DMA transfer is in flight */
+    volatile bool busy;
+    /** Release the owner's chip select when the transfer in flight completes */
+    volatile bool deselect_pending;
+    /** The transfer in flight was started asynchronously, run the owner's transfer callback when it completes */
+    volatile bool notify;
+    /** Current SPI frame configuration of the bus, bytes, pixels or fill */
+    uint8_t frames;
+    /** Source word of fill transfers, must stay valid until they complete */
+    uint16_t fill_color;
+} ILI9341_BusTypeDef;
+#endif
+
+/**
+ * @brief ILI9341 driver statistics
+ */
+typedef struct {
+    /** CASET/RASET commands the address window cache did not have to send */
+    uint32_t window_commands_saved;
+    /** CASET/RASET parameter bytes the address window cache did not have to send */
+    uint32_t window_bytes_saved;
+    /** Memory writes continued with RAMWRC instead of a new address window */
+    uint32_t window_continues;
+    /** Transactions started by the HAL (SPI transfers) and FMC (bus cycles) transports, commands included */
+    uint32_t transfers;
+    /** Bytes sent by the HAL and FMC transports, commands included */
+    uint32_t bytes;
+} ILI9341_StatsTypeDef;
+
+/**
+ * @brief Display list, bus operations recorded into a caller supplied arena for a later replay
+ */
+typedef struct {
+    /** Arena the operations are recorded into, aligned to 4 bytes */
+    uint8_t* arena;
+    /** Usable size of the arena in bytes */
+    size_t size;
+    /** Bytes of the arena used by the recorded operations */
+    size_t used;
+    /** Number of recorded operations */
+    uint32_t operations;
+    /** Number of chip select cycles of the recorded calls */
+    uint32_t selects;
+    /** An operation did not fit into the arena, it and every following one were dropped */
+    bool overflow;
+} ILI9341_DisplayListTypeDef;
+
+/**
+ * @brief Bus traffic a display list replay saved compared to drawing the recorded calls directly
+ */
+typedef struct {
+    /** Operations replayed */
+    uint32_t operations;
+    /** Chip select cycles folded into the single replay burst */
+    uint32_t selects_saved;
+    /** Fills merged into the fill before them, their windows adjoined and they had the same color */
+    uint32_t fills_merged;
+    /** Address windows replaced by another one before any pixel was written to them */
+    uint32_t windows_dropped;
+    /** Commands not sent, merged and dropped windows count as CASET, RASET and RAMWR, plus the window cache savings */
+    uint32_t commands_saved;
+    /** Bytes not sent, counted the same way */
+    uint32_t bytes_saved;
+} ILI9341_DisplayListStatsTypeDef;
+
+// polygon fill rules
+#define ILI9341_FILL_RULE_EVEN_ODD 0  // a pixel is inside if a ray from it crosses the outline an odd number of times
+#define ILI9341_FILL_RULE_NON_ZERO 1  // a pixel is inside if the outline winds around it
+
+/**
+ * @brief Edge of a polygon being filled, x is stepped from scanline to scanline with an exact integer DDA
+ */
+typedef struct {
+    /** X coordinate on the current scanline, rounded down */
+    int32_t x;
+    /** Whole part of the x increment per scanline */
+    int32_t x_step;
+    /** Fractional part of x in 1 / dy units, and its increment per scanline */
+    int32_t error;
+    int32_t error_step;
+    int32_t dy;
+    /** First and last scanline crossed by the edge */
+    int16_t y_start;
+    int16_t y_end;
+    /** 1 for downward edges, -1 for upward edges */
+    int8_t winding;
+} ILI9341_PolygonEdgeTypeDef;
+
+// scratch space ILI9341_FillPolygonWithRule needs for a polygon of n vertices, an edge table entry and an active edge
+// list slot per edge
+#define ILI9341_POLYGON_SCRATCH_SIZE(n) ((size_t)(n) * (sizeof(ILI9341_PolygonEdgeTypeDef) + sizeof(uint16_t)))
+
+// thick line joins
+#define ILI9341_JOIN_MITER 0  // outer edges extended until they meet, beveled past ILI9341_STROKE_MITER_LIMIT
+#define ILI9341_JOIN_BEVEL 1  // outer corners cut straight
+#define ILI9341_JOIN_ROUND 2  // outer corners rounded, ends of open polylines rounded too
+
+// edges of the largest piece of a stroke outline (a join or a cap), the least scratch ILI9341_DrawPolylineThick
+// works with is ILI9341_POLYGON_SCRATCH_SIZE(ILI9341_STROKE_PIECE_EDGES)
+#define ILI9341_STROKE_PIECE_EDGES 16
+
+// scratch space ILI9341_DrawPolylineThick needs to fill a polyline of n vertices in a single pass
+#define ILI9341_STROKE_SCRATCH_SIZE(n) ILI9341_POLYGON_SCRATCH_SIZE((size_t)(n) * (4 + ILI9341_STROKE_PIECE_EDGES))
+
+/**
+ * @brief Rectangle, corners included
+ */
+typedef struct {
+    uint16_t x0;
+    uint16_t y0;
+    uint16_t x1;
+    uint16_t y1;
+} ILI9341_RectTypeDef;
+
+/**
+ * @brief Shadow framebuffer, drawing calls update it and ILI9341_Flush sends the rectangles that changed
+ */
+typedef struct {
+    /** Pixels in RGB565 format, row major, width * height of the display when it was attached */
+    uint16_t* pixels;
+    uint16_t width;
+    uint16_t height;
+    /** Address window and position of the next pixel written */
+    ILI9341_RectTypeDef window;
+    uint16_t x;
+    uint16_t y;
+    /** Pixels are being written to the window, parameter bytes are pixel bytes */
+    bool writing;
+    /** First byte of a pixel written as parameter bytes */
+    bool byte_pending;
+    uint8_t byte;
+    /** Bounding box of the pixels changed since the address window was set */
+    ILI9341_RectTypeDef changed;
+    bool changed_any;
+    /** Areas changed since the last flush */
+    ILI9341_RectTypeDef dirty[ILI9341_DIRTY_RECTS];
+    uint8_t dirty_count;
+    /** The call in progress sent a command to the panel and selected it, drawing alone leaves it unselected */
+    bool panel_selected;
+} ILI9341_FramebufferTypeDef;
+
+/**
+ * @brief Glyph expander, turns glyph bits into RGB565 pixels of the last color pair used
  */
 typedef struct {
+    uint16_t color;
+    uint16_t bgcolor;
+    bool valid;
+    /** Pixels of every 4-bit pattern, most significant bit first, rebuilt when the colors change */
+    uint16_t pixels[16][4];
+} ILI9341_GlyphExpanderTypeDef;
+
+/**
+ * @brief Glyph cache entry, its expanded pixels are stored after the entries in the arena
+ */
+typedef struct {
+    /** Glyph bits of the font, identifies the font, NULL for a free entry */
+    const uint32_t* font_data;
+    uint16_t color;
+    uint16_t bgcolor;
+    uint16_t scale;
+    char ch;
+    /** Value of the cache tick when the glyph was last drawn */
+    uint32_t last_used;
+} ILI9341_GlyphCacheEntryTypeDef;
+
+/**
+ * @brief Cache of expanded glyphs of opaque text, the least recently used glyph is replaced first
+ */
+typedef struct {
+    ILI9341_GlyphCacheEntryTypeDef* entries;
+    /** Pixels of the entries, glyph_pixels each */
+    uint16_t* pixels;
+    uint16_t capacity;
+    uint32_t glyph_pixels;
+    /** Incremented for every line of text drawn */
+    uint32_t tick;
+    /** Characters copied from the cache */
+    uint32_t hits;
+    /** Characters that were not in the cache, expanded into it unless every entry was used by the same line */
+    uint32_t misses;
+} ILI9341_GlyphCacheTypeDef;
+
+/**
+ * @brief ILI9341 handle structure
+ */
+typedef struct __ILI9341_HandleTypeDef {
+    const ILI9341_TransportTypeDef* transport;
+    void* transport_ctx;
+#ifndef ILI9341_HOST_BUILD
     SPI_HandleTypeDef* spi_handle;
     GPIO_TypeDef* cs_port;
     uint16_t cs_pin;
@@ -60,9 +345,37 @@ typedef struct {
     uint16_t dc_pin;
     GPIO_TypeDef* rst_port;
     uint16_t rst_pin;
+    volatile uint32_t* cs_bsrr;
+    volatile uint32_t* dc_bsrr;
+    ILI9341_BusTypeDef* bus;
+#endif
     uint8_t rotation;
     uint16_t width;
     uint16_t height;
+    uint16_t* pixel_buffers;
+    uint16_t pixel_buffer_size;
+    uint8_t pixel_buffer_count;
+    uint8_t pixel_buffer_next;
+    ILI9341_TransferCallback transfer_callback;
+    void* transfer_callback_arg;
+    uint16_t window_x0;
+    uint16_t window_y0;
+    uint16_t window_x1;
+    uint16_t window_y1;
+    bool window_valid;
+    bool window_writing;
+    uint32_t window_written;
+    ILI9341_StatsTypeDef stats;
+    ILI9341_DisplayListTypeDef* display_list;
+    ILI9341_FramebufferTypeDef* framebuffer;
+    /** Clip rectangles pushed with ILI9341_PushClipRect, each inside the previous one, drawing is limited to the last */
+    ILI9341_RectTypeDef clip_stack[ILI9341_CLIP_STACK_DEPTH];
+    uint8_t clip_depth;
+    ILI9341_GlyphExpanderTypeDef glyph_expander;
+    ILI9341_GlyphCacheTypeDef* glyph_cache;
+#ifdef ILI9341_TRACE
+    struct __ILI9341_TraceTypeDef* trace;
+#endif
 } ILI9341_HandleTypeDef;
 
 /**
@@ -71,9 +384,9 @@ typedef struct {
  */
 void ILI9341_Deselect(ILI9341_HandleTypeDef* ili9341);
 
+#ifndef ILI9341_HOST_BUILD
 /**
- * @brief Initialize the ILI9341 display
- * @param ili9341 Pointer to ILI9341 handle structure
+ * @brief Initialize the ILI9341 display connected to an SPI bus through the STM32 HAL
  * @param spi_handle Pointer to the SPI handle
  * @param cs_port GPIO port for Chip Select pin
  * @param cs_pin GPIO pin for Chip Select
@@ -98,6 +411,161 @@ ILI9341_HandleTypeDef ILI9341_Init(
     uint16_t width,
     uint16_t height
 );
+#endif
+
+/**
+ * @brief Reset the display and send the initialization sequence through the handle's transport
+ * @param ili9341 Pointer to ILI9341 handle structure, transport, transport_ctx, rotation, width and height must be set
+ * @note Transport backends call this from their init function, applications normally don't need to call it.
+ */
+void ILI9341_InitDisplay(ILI9341_HandleTypeDef* ili9341);
+
+/**
+ * @brief Attach pixel buffers used to overlap rasterization with transfers
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param buffers Pointer to count * pixels_per_buffer pixels, must stay valid while attached, NULL to detach
+ * @param pixels_per_buffer Number of pixels in each buffer
+ * @param count Number of buffers, at least 2 for the CPU to fill one buffer while another is in flight
+ * @note Images and text are split into buffer sized transfers sent with write_pixel_data_async, the drawing call can
+ * return while the last transfer is still in flight. With the HAL DMA transport on parts with a data cache, the buffers
+ * should be placed in non-cacheable memory (e.g. DTCM).
+ */
+void ILI9341_AttachPixelBuffers(
+    ILI9341_HandleTypeDef* ili9341,
+    uint16_t* buffers,
+    uint16_t pixels_per_buffer,
+    uint8_t count
+);
+
+/**
+ * @brief Set the callback run each time an asynchronous transfer of the handle has completed
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param callback Callback to run, NULL to disable
+ * @param arg User argument passed to the callback
+ */
+void ILI9341_SetTransferCallback(ILI9341_HandleTypeDef* ili9341, ILI9341_TransferCallback callback, void* arg);
+
+/**
+ * @brief Wait until every transfer started by the handle has completed
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @note Call before reusing memory passed to the driver or before touching other devices on the same bus.
+ */
+void ILI9341_Wait(ILI9341_HandleTypeDef* ili9341);
+
+/**
+ * @brief Draw into a shadow framebuffer instead of the display, ILI9341_Flush sends what changed
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param framebuffer Pointer to the framebuffer state, NULL to draw to the display directly again
+ * @param pixels Memory of width * height pixels of the current orientation (150 KB for 320x240), internal SRAM or
+ * external SDRAM, initialized with the content of the display
+ * @note Pixels are only marked dirty when their color changes, redrawing an area with the same content costs no bus
+ * traffic. Drawing calls don't select the panel either, commands other than drawing (scrolling, inversion, reads)
+ * are still sent directly. Attach the framebuffer again after changing the orientation.
+ */
+void ILI9341_AttachFramebuffer(
+    ILI9341_HandleTypeDef* ili9341,
+    ILI9341_FramebufferTypeDef* framebuffer,
+    uint16_t* pixels
+);
+
+/**
+ * @brief Send the areas of the shadow framebuffer that changed since the last flush
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @return Number of pixels sent
+ * @note Changed areas are merged into at most ILI9341_DIRTY_RECTS rectangles, each sent with a single address
+ * window. The function can return while the last transfer is in flight.
+ */
+uint32_t ILI9341_Flush(ILI9341_HandleTypeDef* ili9341);
+
+/**
+ * @brief Keep expanded glyphs of opaque text in caller memory, drawing them again is a copy
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param cache Pointer to the cache state, NULL to stop caching
+ * @param arena Memory holding the entries and their pixels, must stay valid while attached
+ * @param size Size of the arena in bytes
+ * @param glyph_pixels Pixels of the largest glyph to cache, width * height * scale * scale, larger glyphs are expanded
+ * each time they are drawn
+ * @note Glyphs are keyed by font, character, colors and scale, the arena holds about
+ * size / (sizeof(ILI9341_GlyphCacheEntryTypeDef) + glyph_pixels * 2) of them. The hits and misses of the cache count
+ * the characters drawn by ILI9341_WriteString and ILI9341_WriteStringScaled.
+ */
+void ILI9341_AttachGlyphCache(
+    ILI9341_HandleTypeDef* ili9341,
+    ILI9341_GlyphCacheTypeDef* cache,
+    void* arena,
+    size_t size,
+    uint32_t glyph_pixels
+);
+
+/**
+ * @brief Start recording the drawing calls of the handle into a display list instead of sending them
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param list Pointer to the display list to record into, must stay valid until the recording ends
+ * @param arena Memory the operations are stored in, must stay valid while the list is in use
+ * @param size Size of the arena in bytes
+ * @note Drawing calls store the address windows, fills, pixels and commands they would send, fills take a few bytes
+ * while pixel data (text, images) is copied. Reading functions must not be called while recording.
+ */
+void ILI9341_BeginDisplayList(
+    ILI9341_HandleTypeDef* ili9341,
+    ILI9341_DisplayListTypeDef* list,
+    void* arena,
+    size_t size
+);
+
+/**
+ * @brief Stop recording, drawing calls are sent to the display again
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @return true if every operation fit into the arena, false if the list overflowed and is incomplete
+ */
+bool ILI9341_EndDisplayList(ILI9341_HandleTypeDef* ili9341);
+
+/**
+ * @brief Send a recorded display list to the display in a single chip select cycle
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param list Pointer to the recorded display list, can be replayed any number of times
+ * @param stats Pointer to a structure receiving the traffic saved by the replay, NULL if not needed
+ * @note Adjoining fills of the same color are merged into one address window and one fill, windows that are replaced
+ * before being written to are dropped and the remaining ones go through the address window cache. The replay can
+ * return while the last transfer is in flight, call ILI9341_Wait before modifying the arena.
+ */
+void ILI9341_ReplayDisplayList(
+    ILI9341_HandleTypeDef* ili9341,
+    const ILI9341_DisplayListTypeDef* list,
+    ILI9341_DisplayListStatsTypeDef* stats
+);
+
+/**
+ * @brief Render a recorded display list into strips of full width lines and send them, for a composited, tear-free
+ * full screen update without a full framebuffer
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param list Pointer to the recorded display list (the scene), drawn in recording order
+ * @param buffers Memory of count strips of width * lines pixels each, 320x16 is 10 KB
+ * @param lines Number of lines of a strip
+ * @param count Number of strips, with 2 or more a strip renders while the previous one is sent (with DMA)
+ * @param background Color of the pixels the scene does not draw
+ * @note Every recorded address window is clipped to the strip being rendered, operations outside of it are skipped.
+ * Commands of the list other than memory writes (scrolling, inversion) are not sent.
+ */
+void ILI9341_RenderStrips(
+    ILI9341_HandleTypeDef* ili9341,
+    const ILI9341_DisplayListTypeDef* list,
+    uint16_t* buffers,
+    uint16_t lines,
+    uint8_t count,
+    uint16_t background
+);
+
+#ifndef ILI9341_HOST_BUILD
+/**
+ * @brief Notify the driver that a DMA transfer has completed, only needed with ILI9341_ENABLE_DMA
+ * @param hspi Pointer to the SPI handle passed to HAL_SPI_TxCpltCallback
+ * @return true if the transfer belonged to a display, false if the bus is not used by any display
+ * @note Call from HAL_SPI_TxCpltCallback, the transfer is matched to its display by SPI instance so several displays
+ * on different buses can stream at the same time.
+ */
+bool ILI9341_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi);
+#endif
 
 /**
  * @brief Set display orientation
@@ -106,6 +574,26 @@ ILI9341_HandleTypeDef ILI9341_Init(
  */
 void ILI9341_SetOrientation(ILI9341_HandleTypeDef* ili9341, uint8_t rotation, uint8_t scrollBit);
 
+/**
+ * @brief Limit drawing to a rectangle, within the current clip rectangle
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x X coordinate of the top-left corner of the rectangle
+ * @param y Y coordinate of the top-left corner of the rectangle
+ * @param w Width of the rectangle in pixels
+ * @param h Height of the rectangle in pixels
+ * @return true if the rectangle was pushed, false if ILI9341_CLIP_STACK_DEPTH rectangles are pushed already
+ * @note The new clip rectangle is the intersection with the current one and can be empty. Every drawing function clips
+ * its spans to it, and shapes entirely outside of it are dropped before they are rasterized. Without any rectangle
+ * pushed drawing is clipped to the display.
+ */
+bool ILI9341_PushClipRect(ILI9341_HandleTypeDef* ili9341, int16_t x, int16_t y, int16_t w, int16_t h);
+
+/**
+ * @brief Restore the clip rectangle in effect before the last ILI9341_PushClipRect
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+void ILI9341_PopClipRect(ILI9341_HandleTypeDef* ili9341);
+
 /**
  * @brief Draw a single pixel at specified coordinates
  * @param ili9341 Pointer to ILI9341 handle structure
@@ -143,6 +631,8 @@ void ILI9341_FillScreen(ILI9341_HandleTypeDef* ili9341, uint16_t color);
  * @param color 16-bit text color in RGB565 format
  * @param bgcolor 16-bit background color in RGB565 format
  * @param tracking Additional space in pixels between characters, can be negative
+ * @note The whole line is sent in one address window, the gaps left by a positive tracking are filled with bgcolor.
+ * Where characters overlap (negative tracking) a pixel has the text color if any of them sets it.
  */
 void ILI9341_WriteString(
     ILI9341_HandleTypeDef* ili9341,
@@ -166,7 +656,8 @@ void ILI9341_WriteString(
  * @param bgcolor 16-bit background color in RGB565 format
  * @param scale Scaling factor for the font, must be >= 1
  * @param tracking Additional space in pixels between characters, can be negative
- * @note This function does not support clipping, any characters that would go beyond the display width are not drawn.
+ * @note The whole line is sent in one address window, the gaps left by a positive tracking are filled with bgcolor.
+ * Where characters overlap (negative tracking) a pixel has the text color if any of them sets it.
  */
 void ILI9341_WriteStringScaled(
     ILI9341_HandleTypeDef* ili9341,
@@ -210,7 +701,6 @@ void ILI9341_WriteStringTransparent(
  * @param color 16-bit text color in RGB565 format
  * @param scale Scaling factor for the font, must be >= 1
  * @param tracking Additional space in pixels between characters, can be negative
- * @note This function does not support clipping, any characters that would go beyond the display width are not drawn.
  */
 void ILI9341_WriteStringTransparentScaled(
     ILI9341_HandleTypeDef* ili9341,
@@ -230,8 +720,9 @@ void ILI9341_WriteStringTransparentScaled(
  * @param y Y coordinate of the top-left corner of the image
  * @param w Width of the image in pixels
  * @param h Height of the image in pixels
- * @param data Pointer to the image pixel data in RGB565 format with the 2 bytes swapped, must contain at least w*h
- * elements
+ * @param data Pointer to the image pixel data in RGB565 format, must contain at least w*h elements
+ * @note With ILI9341_SWAPPED_IMAGES defined the 2 bytes of each pixel are expected to be swapped. Only the part of the
+ * image inside the clip rectangle is sent, in a single address window.
  */
 void ILI9341_DrawImage(
     ILI9341_HandleTypeDef* ili9341,
@@ -243,14 +734,14 @@ void ILI9341_DrawImage(
 );
 
 /**
- * @brief Draw an image (bitmap) at specified coordinates, clip out of bounds pixels
+ * @brief Draw an image (bitmap) at specified coordinates, which can be negative, clip out of bounds pixels
  * @param ili9341 Pointer to ILI9341 handle structure
  * @param x X coordinate of the top-left corner of the image
  * @param y Y coordinate of the top-left corner of the image
  * @param w Width of the image in pixels
  * @param h Height of the image in pixels
- * @param data Pointer to the image pixel data in RGB565 format with the 2 bytes swapped, must contain at least w*h
- * elements
+ * @param data Pointer to the image pixel data in RGB565 format, must contain at least w*h elements
+ * @note With ILI9341_SWAPPED_IMAGES defined the 2 bytes of each pixel are expected to be swapped.
  */
 void ILI9341_DrawImageWithClip(
     ILI9341_HandleTypeDef* ili9341,
@@ -261,6 +752,52 @@ void ILI9341_DrawImageWithClip(
     const uint16_t* data
 );
 
+/**
+ * @brief Read a rectangle of pixels back from the display memory
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x X coordinate of the top-left corner of the rectangle
+ * @param y Y coordinate of the top-left corner of the rectangle
+ * @param w Width of the rectangle in pixels
+ * @param h Height of the rectangle in pixels
+ * @param pixels Buffer receiving the w*h pixels as native RGB565 words, row by row, ILI9341_SWAPPED_IMAGES does not
+ * apply
+ * @return true if the pixels were read, false if the rectangle is not entirely on the display or a display list is
+ * being recorded
+ * @note The panel sends 18-bit pixels, they are converted back to the RGB565 colors that were written. The HAL
+ * transport lowers the SPI clock to ILI9341_READ_SPI_MAX_HZ while it reads, with the FMC transport the read timings of
+ * the memory controller must meet the panel's read cycle. With a framebuffer attached the pixels are copied from it,
+ * including the changes not flushed yet.
+ */
+bool ILI9341_ReadRect(
+    ILI9341_HandleTypeDef* ili9341,
+    uint16_t x,
+    uint16_t y,
+    uint16_t w,
+    uint16_t h,
+    uint16_t* pixels
+);
+
+/**
+ * @brief Stream the display contents, a chunk of rows at a time, in the format read by screenshot_to_png.py
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param buffer Buffer the rows are read into, at least one row
+ * @param buffer_size Number of pixels in the buffer, chunks are as many whole rows as it holds
+ * @param write Function receiving the stream (e.g. a UART or file writer)
+ * @param arg Argument passed to the write function
+ * @return true if the whole screen was written, false if the buffer can't hold a row, a display list is being
+ * recorded or the write function aborted
+ * @note The rows are read back from the display memory like ILI9341_ReadRect, the display must not be drawn to from
+ * the write function. With a framebuffer attached the framebuffer is written as a single chunk and the buffer is not
+ * used (it can be NULL). Pixels are written as native RGB565 words, little endian on Cortex-M.
+ */
+bool ILI9341_Screenshot(
+    ILI9341_HandleTypeDef* ili9341,
+    uint16_t* buffer,
+    uint32_t buffer_size,
+    ILI9341_ScreenshotWriteFunc write,
+    void* arg
+);
+
 /**
  * @brief Invert the display colors
  * @param ili9341 Pointer to ILI9341 handle structure
@@ -289,6 +826,7 @@ void ILI9341_DrawLine(ILI9341_HandleTypeDef* ili9341, int16_t x1, int16_t y1, in
  * @param color 16-bit line color in RGB565 format
  * @param thickness Line thickness in pixels, must be >= 1
  * @param cap true to draw rounded line caps, false for no caps
+ * @note Lines thicker than 1 pixel are stroked with ILI9341_DrawPolylineThick using scratch space on the stack.
  */
 void ILI9341_DrawLineThick(
     ILI9341_HandleTypeDef* ili9341,
@@ -389,8 +927,10 @@ void ILI9341_DrawPolygon(ILI9341_HandleTypeDef* ili9341, int16_t* x, int16_t* y,
  * @param n Number of vertices in the polygon
  * @param color 16-bit polygon color in RGB565 format
  * @param thickness Line thickness in pixels, must be >= 1
- * @param cap true to draw rounded line caps, false for no caps
- * @note The polygon is automatically closed by connecting the last vertex to the first.
+ * @param cap true for round joins, false for miter joins
+ * @note The polygon is automatically closed by connecting the last vertex to the first. The outline is stroked with
+ * ILI9341_DrawPolylineThick using scratch space on the stack for ILI9341_POLYGON_STACK_EDGES edges, larger outlines are
+ * filled in several passes.
  */
 void ILI9341_DrawPolygonThick(
     ILI9341_HandleTypeDef* ili9341,
@@ -403,17 +943,138 @@ void ILI9341_DrawPolygonThick(
 );
 
 /**
- * @brief Fill a polygon
+ * @brief Fill a polygon with the even-odd rule
  * @param ili9341 Pointer to ILI9341 handle structure
  * @param x Array of X coordinates of the polygon vertices
  * @param y Array of Y coordinates of the polygon vertices
  * @param n Number of vertices in the polygon
  * @param color 16-bit polygon color in RGB565 format
- * @note The algorithm used is scanline algorithm, with support for concave and self-intersecting polygons. Max
- * intersections for scanline is 32.
+ * @note The algorithm used is scanline algorithm, with support for concave and self-intersecting polygons. The edge
+ * table is kept on the stack, polygons with more than ILI9341_POLYGON_STACK_EDGES non-horizontal edges are filled in
+ * bands of scanlines, ILI9341_FillPolygonWithRule with enough scratch space fills them in a single pass.
  */
 void ILI9341_FillPolygon(ILI9341_HandleTypeDef* ili9341, int16_t* x, int16_t* y, uint16_t n, uint16_t color);
 
+/**
+ * @brief Fill a polygon of any number of vertices with the given fill rule, using caller provided scratch space
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x Array of X coordinates of the polygon vertices
+ * @param y Array of Y coordinates of the polygon vertices
+ * @param n Number of vertices in the polygon
+ * @param color 16-bit polygon color in RGB565 format
+ * @param rule ILI9341_FILL_RULE_EVEN_ODD or ILI9341_FILL_RULE_NON_ZERO
+ * @param scratch Scratch space, aligned for ILI9341_PolygonEdgeTypeDef
+ * @param scratch_size Size of the scratch space in bytes, ILI9341_POLYGON_SCRATCH_SIZE(n) is always enough
+ * @return true if the polygon was filled, false if the scratch space is too small
+ * @note Edges are sorted once into an edge table by their first scanline, each scanline only steps the x of the active
+ * edges and keeps them sorted, there is no limit on the number of crossings. An edge covers the scanlines below its
+ * top vertex down to its bottom vertex included, at x = x_top + (y - y_top) * dx / dy rounded down. Spans are filled
+ * between the crossings, both ends included, touching spans of a scanline are sent as one.
+ */
+bool ILI9341_FillPolygonWithRule(
+    ILI9341_HandleTypeDef* ili9341,
+    const int16_t* x,
+    const int16_t* y,
+    uint16_t n,
+    uint16_t color,
+    uint8_t rule,
+    void* scratch,
+    size_t scratch_size
+);
+
+/**
+ * @brief Draw a thick polyline or polygon outline as a single shape
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x Array of X coordinates of the vertices
+ * @param y Array of Y coordinates of the vertices
+ * @param n Number of vertices
+ * @param color 16-bit line color in RGB565 format
+ * @param thickness Line thickness in pixels
+ * @param join One of ILI9341_JOIN_* values
+ * @param closed true to connect the last vertex to the first
+ * @param scratch Scratch space, aligned for ILI9341_PolygonEdgeTypeDef
+ * @param scratch_size Size of the scratch space in bytes, ILI9341_STROKE_SCRATCH_SIZE(n) fills the stroke in one pass
+ * @note Segments, joins and round caps are turned into pieces of outline in fixed point with 1/16 pixel precision and
+ * filled together with the non-zero rule, so every pixel is sent once. With less scratch space the pieces are filled
+ * in several passes and pixels where passes overlap are sent again; nothing is drawn with less than
+ * ILI9341_POLYGON_SCRATCH_SIZE(ILI9341_STROKE_PIECE_EDGES). Open polylines have round ends with round joins and flat
+ * ends through the end vertices otherwise.
+ */
+void ILI9341_DrawPolylineThick(
+    ILI9341_HandleTypeDef* ili9341,
+    const int16_t* x,
+    const int16_t* y,
+    uint16_t n,
+    uint16_t color,
+    uint16_t thickness,
+    uint8_t join,
+    bool closed,
+    void* scratch,
+    size_t scratch_size
+);
+
+/**
+ * @brief Draw an anti-aliased line between two points
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x1 X coordinate of the start point
+ * @param y1 Y coordinate of the start point
+ * @param x2 X coordinate of the end point
+ * @param y2 Y coordinate of the end point
+ * @param color 16-bit line color in RGB565 format
+ * @param background 16-bit color the line is blended with, when no framebuffer is attached
+ * @note Each step along the line covers 2 pixels across it, blended with color by how close they are to the line.
+ * With a framebuffer attached they are blended with the framebuffer pixels, so the line can cross anything, otherwise
+ * it must be drawn over a solid background color. Steps covering the same pair of pixels are sent in one address
+ * window.
+ */
+void ILI9341_DrawLineAA(
+    ILI9341_HandleTypeDef* ili9341,
+    int16_t x1,
+    int16_t y1,
+    int16_t x2,
+    int16_t y2,
+    uint16_t color,
+    uint16_t background
+);
+
+/**
+ * @brief Draw an anti-aliased circle outline
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param xc X coordinate of the center of the circle
+ * @param yc Y coordinate of the center of the circle
+ * @param r Radius of the circle
+ * @param color 16-bit circle color in RGB565 format
+ * @param background 16-bit color the circle is blended with, when no framebuffer is attached
+ * @note Blended like ILI9341_DrawLineAA, every pixel of the outline is sent once.
+ */
+void ILI9341_DrawCircleAA(
+    ILI9341_HandleTypeDef* ili9341,
+    int16_t xc,
+    int16_t yc,
+    uint16_t r,
+    uint16_t color,
+    uint16_t background
+);
+
+/**
+ * @brief Draw an anti-aliased polygon outline
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x Array of X coordinates of the vertices
+ * @param y Array of Y coordinates of the vertices
+ * @param n Number of vertices
+ * @param color 16-bit polygon color in RGB565 format
+ * @param background 16-bit color the polygon is blended with, when no framebuffer is attached
+ * @note The edges are drawn with ILI9341_DrawLineAA, the last vertex is connected to the first one.
+ */
+void ILI9341_DrawPolygonAA(
+    ILI9341_HandleTypeDef* ili9341,
+    const int16_t* x,
+    const int16_t* y,
+    uint16_t n,
+    uint16_t color,
+    uint16_t background
+);
+
 void ILI9341_DefineVerticalScrollArea(ILI9341_HandleTypeDef* ili9341, uint16_t topFixedLines, uint16_t bottomFixedLines);
 
 void ILI9341_DoVerticalScroll(ILI9341_HandleTypeDef* ili9341, uint16_t lines);
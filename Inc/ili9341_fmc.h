@@ -0,0 +1,60 @@
+/* vim: set ai et ts=4 sw=4: */
+#ifndef __ILI9341_FMC_H__
+#define __ILI9341_FMC_H__
+
+#include "ili9341.h"
+#include "stdbool.h"
+#include "stdint.h"
+
+// Register access used by the FMC transport, can be defined when building ili9341_fmc.c (e.g. on the compiler command
+// line) to trace or redirect the bus accesses, for example into a mock memory region on a host
+#ifndef ILI9341_FMC_WRITE
+#define ILI9341_FMC_WRITE(reg, value) (*(reg) = (value))
+#endif
+#ifndef ILI9341_FMC_READ
+#define ILI9341_FMC_READ(reg) (*(reg))
+#endif
+
+/**
+ * @brief 8080 parallel bus of a display wired to the FMC (or any other memory mapped interface)
+ * @note The D/C line is wired to an address line, so a command is a write to one address and data is a write to
+ * another. Chip select is driven by the memory controller. With FMC bank 1 and D/C on A16 of a 16-bit bus for example,
+ * command is 0x60000000 and data is 0x60020000 (the FMC shifts addresses by one for 16-bit memories). The bank must
+ * have the memory data width of the bus, an 8-bit bus is accessed with byte loads and stores.
+ */
+typedef struct {
+    /** Address the command bytes are written to (D/C low) */
+    volatile uint16_t* command;
+    /** Address the parameter and pixel data are written to and read from (D/C high) */
+    volatile uint16_t* data;
+    /** true for a 16-bit bus (IM pins set to 16-bit 8080), false for an 8-bit bus accessed a byte at a time */
+    bool bus_16bit;
+#ifndef ILI9341_HOST_BUILD
+    /** Reset pin, NULL if the reset line is tied to the MCU reset */
+    GPIO_TypeDef* rst_port;
+    uint16_t rst_pin;
+#endif
+    /** Transport state, the last command was a memory write and data bytes are pixels */
+    bool memory_write;
+    /** Transport state, the last command was a memory read and the panel sends 2 color components per read cycle on
+     * a 16-bit bus, after a dummy cycle */
+    bool memory_read;
+    bool dummy_read;
+    /** Transport state, on a 16-bit bus the first byte of a pixel split across write_data calls, or the second color
+     * component of the last read cycle not handed out yet */
+    int16_t pending_byte;
+} ILI9341_FMC_BusTypeDef;
+
+/**
+ * @brief Initialize a display handle on an 8080 parallel bus
+ * @param bus Pointer to the bus description, command, data and bus_16bit (and the reset pin when available) must be
+ * set, must outlive the returned handle
+ * @param rotation Initial display rotation, one of ILI9341_ROTATION_* values
+ * @param width Display width in pixels
+ * @param height Display height in pixels
+ * @return Initialized ILI9341_HandleTypeDef structure
+ * @note The memory controller must be configured before (e.g. HAL_SRAM_Init generated by CubeMX).
+ */
+ILI9341_HandleTypeDef ILI9341_FMC_Init(ILI9341_FMC_BusTypeDef* bus, uint8_t rotation, uint16_t width, uint16_t height);
+
+#endif  // __ILI9341_FMC_H__
@@ -0,0 +1,130 @@
+/* vim: set ai et ts=4 sw=4: */
+#ifndef __ILI9341_SIM_H__
+#define __ILI9341_SIM_H__
+
+#include "ili9341.h"
+#include "stdbool.h"
+#include "stdint.h"
+
+// Native (portrait) GRAM size of the ILI9341
+#define ILI9341_SIM_GRAM_WIDTH 240
+#define ILI9341_SIM_GRAM_HEIGHT 320
+
+/**
+ * @brief Bus traffic counters of the simulated panel
+ */
+typedef struct {
+    /** Number of select calls */
+    uint32_t selects;
+    /** Number of command bytes written (DC low) */
+    uint32_t commands;
+    /** Number of bytes written with DC high, parameters and pixels */
+    uint32_t data_bytes;
+    /** Number of bytes read back */
+    uint32_t read_bytes;
+    /** Number of transport calls that moved bytes over the bus */
+    uint32_t transactions;
+    /** Number of DC level changes */
+    uint32_t dc_toggles;
+    /** Number of pixels stored into GRAM */
+    uint32_t pixels;
+    /** Number of bytes sent or received while the panel was not selected */
+    uint32_t errors;
+} ILI9341_Sim_StatsTypeDef;
+
+/**
+ * @brief Simulated ILI9341 panel, decodes the command stream into an in-memory GRAM model
+ * @note The structure is large (about 150 KB), allocate it statically or on the heap.
+ */
+typedef struct {
+    /** Frame memory in native portrait order, pixels are stored as written (RGB565) */
+    uint16_t gram[ILI9341_SIM_GRAM_HEIGHT][ILI9341_SIM_GRAM_WIDTH];
+    /** Column address window set by CASET */
+    uint16_t col_start;
+    uint16_t col_end;
+    /** Page (row) address window set by RASET */
+    uint16_t page_start;
+    uint16_t page_end;
+    /** Current memory pointer */
+    uint16_t col;
+    uint16_t page;
+    /** Memory access control set by MADCTL */
+    uint8_t madctl;
+    /** Pixel format set by PIXSET */
+    uint8_t pixel_format;
+    /** Vertical scrolling definition set by VSCRDEF and VSCRSADD */
+    uint16_t top_fixed_lines;
+    uint16_t scroll_lines;
+    uint16_t bottom_fixed_lines;
+    uint16_t scroll_start;
+    bool inverted;
+    bool display_on;
+    bool sleeping;
+    bool selected;
+    /** Decoder state */
+    bool dc;
+    uint8_t cmd;
+    uint8_t params[16];
+    uint8_t param_count;
+    uint8_t pixel_msb;
+    bool pixel_half;
+    bool read_dummy;
+    uint8_t read_component;
+    ILI9341_Sim_StatsTypeDef stats;
+} ILI9341_Sim_PanelTypeDef;
+
+/**
+ * @brief Initialize a display handle backed by a simulated panel
+ * @param panel Pointer to the simulated panel, must outlive the returned handle
+ * @param rotation Initial display rotation, one of ILI9341_ROTATION_* values
+ * @param width Display width in pixels
+ * @param height Display height in pixels
+ * @return Initialized ILI9341_HandleTypeDef structure
+ */
+ILI9341_HandleTypeDef ILI9341_Sim_Init(
+    ILI9341_Sim_PanelTypeDef* panel,
+    uint8_t rotation,
+    uint16_t width,
+    uint16_t height
+);
+
+/**
+ * @brief Clear the bus traffic counters of the simulated panel
+ * @param panel Pointer to the simulated panel
+ */
+void ILI9341_Sim_ResetStats(ILI9341_Sim_PanelTypeDef* panel);
+
+/**
+ * @brief Read a pixel from GRAM at the given logical coordinates, as mapped by the current MADCTL setting
+ * @param panel Pointer to the simulated panel
+ * @param x Column address, as the driver would send it with CASET
+ * @param y Page address, as the driver would send it with RASET
+ * @return 16-bit pixel color in RGB565 format, 0 if the coordinates are outside of the address space
+ */
+uint16_t ILI9341_Sim_ReadPixel(ILI9341_Sim_PanelTypeDef* panel, uint16_t x, uint16_t y);
+
+/**
+ * @brief Render the image currently shown on the glass, applying vertical scrolling and color inversion
+ * @param panel Pointer to the simulated panel
+ * @param frame Output buffer of ILI9341_SIM_GRAM_WIDTH * ILI9341_SIM_GRAM_HEIGHT RGB565 pixels, row major
+ * @note The image is in portrait orientation as seen on the module, which is GRAM mirrored horizontally.
+ */
+void ILI9341_Sim_Snapshot(ILI9341_Sim_PanelTypeDef* panel, uint16_t* frame);
+
+/**
+ * @brief Save the image currently shown on the glass as a binary PPM file
+ * @param panel Pointer to the simulated panel
+ * @param path Output file path
+ * @return true if the file was written, false otherwise
+ */
+bool ILI9341_Sim_SavePPM(ILI9341_Sim_PanelTypeDef* panel, const char* path);
+
+/**
+ * @brief Compute the time the counted traffic would take on a serial bus
+ * @param stats Pointer to the counters
+ * @param spi_hz SPI clock in Hz
+ * @return Bus time in nanoseconds, assuming 8 clocks per byte and no gaps between bytes
+ */
+uint64_t ILI9341_Sim_BusTimeNs(const ILI9341_Sim_StatsTypeDef* stats, uint32_t spi_hz);
+
+#endif  // __ILI9341_SIM_H__
@@ -0,0 +1,152 @@
+/* vim: set ai et ts=4 sw=4: */
+#ifndef __ILI9341_TRACE_H__
+#define __ILI9341_TRACE_H__
+
+#include "ili9341.h"
+#include "stdbool.h"
+#include "stdint.h"
+
+// Timestamp stored with each event, can be defined when building ili9341_trace.c to use another clock. The cycle
+// counter must be enabled by the application (DWT->CTRL CYCCNTENA).
+#ifndef ILI9341_TRACE_TIMESTAMP
+#ifndef ILI9341_HOST_BUILD
+#define ILI9341_TRACE_TIMESTAMP() (DWT->CYCCNT)
+#define ILI9341_TRACE_TIMESTAMP_HZ() (SystemCoreClock)
+#else
+#define ILI9341_TRACE_TIMESTAMP() 0
+#define ILI9341_TRACE_TIMESTAMP_HZ() 0
+#endif
+#endif
+
+// Number of bytes of each transfer stored in its event, enough for every address window and fill
+#define ILI9341_TRACE_DATA_SIZE 12
+
+// Binary trace format, a header followed by the events, all fields little endian
+#define ILI9341_TRACE_MAGIC "I9TR"
+#define ILI9341_TRACE_VERSION 1
+#define ILI9341_TRACE_HEADER_SIZE 16  // magic, version (16 bits), event size (16 bits), event count, timestamp Hz
+#define ILI9341_TRACE_EVENT_SIZE 24   // timestamp, length, type, command, captured bytes, reserved, data
+
+// Trace event types
+#define ILI9341_TRACE_SELECT 0    // chip select asserted
+#define ILI9341_TRACE_DESELECT 1  // chip select released
+#define ILI9341_TRACE_RESET 2     // hardware reset
+#define ILI9341_TRACE_COMMAND 3   // command byte, DC low
+#define ILI9341_TRACE_DATA 4      // parameter or pixel bytes, DC high
+#define ILI9341_TRACE_PIXELS 5    // RGB565 pixels sent from a buffer, DC high, data is the first pixels as on the bus
+#define ILI9341_TRACE_FILL 6      // one color repeated, DC high, data is the color as on the bus
+#define ILI9341_TRACE_FRAME 7     // frame boundary marked by the application
+#define ILI9341_TRACE_READ 8      // bytes received after a read command, DC high, data is the first bytes received
+
+/**
+ * @brief Trace event, one bus operation of the driver
+ */
+typedef struct {
+    /** ILI9341_TRACE_TIMESTAMP value when the operation started */
+    uint32_t timestamp;
+    /** Number of bytes moved over the bus, 2 per pixel for pixels and fills, received bytes for reads */
+    uint32_t length;
+    /** One of ILI9341_TRACE_* values */
+    uint8_t type;
+    /** Command byte, for data, pixels and fills the command they belong to */
+    uint8_t command;
+    /** Number of bytes stored in data, the first ones of the transfer */
+    uint8_t data_length;
+    uint8_t data[ILI9341_TRACE_DATA_SIZE];
+} ILI9341_TraceEventTypeDef;
+
+/**
+ * @brief Trace, a ring buffer of events, the oldest ones are overwritten when it is full
+ */
+typedef struct __ILI9341_TraceTypeDef {
+    ILI9341_TraceEventTypeDef* events;
+    uint32_t capacity;
+    /** Index the next event is stored at */
+    uint32_t head;
+    /** Number of events stored */
+    uint32_t count;
+    /** Number of events overwritten since the trace was cleared */
+    uint32_t dropped;
+    /** Frequency of the timestamps, 0 if unknown */
+    uint32_t timestamp_hz;
+    /** Last command written, tags the data events */
+    uint8_t command;
+    /** Recording is paused */
+    bool paused;
+} ILI9341_TraceTypeDef;
+
+/**
+ * @brief Function receiving the exported trace
+ * @param data Pointer to the next chunk of the trace
+ * @param size Size of the chunk in bytes
+ * @param arg Argument given to the export function
+ * @return true to continue, false to abort the export
+ */
+typedef bool (*ILI9341_TraceWriteFunc)(const void* data, size_t size, void* arg);
+
+/**
+ * @brief Start tracing the bus operations of a display
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param trace Pointer to the trace to record into, NULL to stop tracing
+ * @param events Ring buffer of events
+ * @param capacity Number of events in the ring buffer
+ * @note Only available when the driver is built with ILI9341_TRACE defined. Operations of a display list are traced
+ * when it is replayed.
+ */
+void ILI9341_AttachTrace(
+    ILI9341_HandleTypeDef* ili9341,
+    ILI9341_TraceTypeDef* trace,
+    ILI9341_TraceEventTypeDef* events,
+    uint32_t capacity
+);
+
+/**
+ * @brief Remove every event from a trace
+ * @param trace Pointer to the trace
+ */
+void ILI9341_TraceClear(ILI9341_TraceTypeDef* trace);
+
+/**
+ * @brief Record a bus operation, called by the driver
+ * @param trace Pointer to the trace
+ * @param type One of ILI9341_TRACE_* values
+ * @param data Pointer to the bytes as sent on the bus, NULL if none
+ * @param length Number of bytes of the operation
+ */
+void ILI9341_TraceRecord(ILI9341_TraceTypeDef* trace, uint8_t type, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief Record pixels sent from a buffer, called by the driver
+ * @param trace Pointer to the trace
+ * @param pixels Pointer to the pixels in RGB565 format
+ * @param count Number of pixels
+ */
+void ILI9341_TraceRecordPixels(ILI9341_TraceTypeDef* trace, const uint16_t* pixels, size_t count);
+
+/**
+ * @brief Mark the end of a frame, the replayer saves an image of the panel at each mark
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+void ILI9341_TraceMarkFrame(ILI9341_HandleTypeDef* ili9341);
+
+/**
+ * @brief Export a trace in the binary format read by trace_replay.c, oldest event first
+ * @param trace Pointer to the trace
+ * @param write Function receiving the exported bytes (e.g. a UART or file writer)
+ * @param arg Argument passed to the write function
+ * @return true if the whole trace was written, false if the write function aborted
+ * @note Pause the trace during the export if the display is drawn to from an interrupt.
+ */
+bool ILI9341_TraceExportBinary(const ILI9341_TraceTypeDef* trace, ILI9341_TraceWriteFunc write, void* arg);
+
+/**
+ * @brief Export a trace as CSV text, one line per event, oldest event first
+ * @param trace Pointer to the trace
+ * @param write Function receiving the exported text
+ * @param arg Argument passed to the write function
+ * @return true if the whole trace was written, false if the write function aborted
+ * @note Columns are timestamp, event, dc, command, length and data (the captured bytes in hexadecimal).
+ */
+bool ILI9341_TraceExportCSV(const ILI9341_TraceTypeDef* trace, ILI9341_TraceWriteFunc write, void* arg);
+
+#endif  // __ILI9341_TRACE_H__
@@ -2,25 +2,234 @@
 #include "ili9341.h"
 #include <stdbool.h>
 #include <stdint.h>
-#include "main.h"
 #include <string.h>
+#ifdef ILI9341_TRACE
+#include "ili9341_trace.h"
+#endif
+
+// display list operation types
+#define ILI9341_LIST_WINDOW 1   // address window, 4 coordinates as payload
+#define ILI9341_LIST_FILL 2     // count pixels of color
+#define ILI9341_LIST_PIXELS 3   // count pixels as payload
+#define ILI9341_LIST_COMMAND 4  // command byte
+#define ILI9341_LIST_DATA 5     // count parameter bytes as payload
+
+// thick strokes
+#define ILI9341_STROKE_SUBPIXEL_BITS 4  // fractional bits of the outline coordinates
+#define ILI9341_STROKE_ARC_STEPS 6      // most points per quarter turn of the round joins and caps
+
+// anti-aliased runs
+#define ILI9341_AA_RUN_STEPS 32     // most steps along the major axis sent in one address window
+#define ILI9341_AA_RUN_FIRST 0x01   // draw the first pixel of the pair
+#define ILI9341_AA_RUN_SECOND 0x02  // draw the second pixel of the pair
+#define ILI9341_AA_RUN_INVERT 0x04  // the coverage given is the first pixel's, the second one is covered by the rest
+#define ILI9341_AA_RUN_REVERSE 0x08 // the coverage is given from the last step to the first one
+
+// glyph expansion, SIMD unless ILI9341_NO_GLYPH_SIMD is defined, the lookup table of the expander otherwise
+#ifndef ILI9341_NO_GLYPH_SIMD
+#if !defined(ILI9341_HOST_BUILD)
+#define ILI9341_GLYPH_SIMD_WORD  // halfword masks blending the colors, 2 pixels per 32-bit word
+#elif defined(ILI9341_HOST_BUILD) && defined(__GNUC__)
+#define ILI9341_GLYPH_SIMD_VECTOR  // GCC/Clang vector extensions, 8 pixels per operation
+typedef uint16_t ILI9341_Pixels8 __attribute__((vector_size(16)));
+#endif
+#endif
 
-#include "stm32f7xx_hal.h"
-#include "stm32f7xx_hal_spi.h"
-#include "main.h"
+/**
+ * @brief Header of a display list operation, followed by its payload padded to 4 bytes
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t command;
+    uint16_t color;
+    uint32_t count;
+} ILI9341_ListOpTypeDef;
+
+/**
+ * @brief Stroke being built, closed pieces of outline collected into an edge table and filled together
+ */
+typedef struct {
+    ILI9341_HandleTypeDef* ili9341;
+    ILI9341_PolygonEdgeTypeDef* edges;
+    uint16_t* active;
+    uint16_t capacity;
+    uint16_t count;
+    uint16_t color;
+} ILI9341_StrokeTypeDef;
+
+/**
+ * @brief Append an operation to the display list being recorded
+ * @param list Pointer to the display list
+ * @param type One of ILI9341_LIST_* values
+ * @param command Command byte of ILI9341_LIST_COMMAND operations
+ * @param color Color of ILI9341_LIST_FILL operations
+ * @param count Pixel or byte count
+ * @param payload Pointer to the payload, NULL if none
+ * @param payload_size Size of the payload in bytes
+ */
+static void ILI9341_ListAppend(
+    ILI9341_DisplayListTypeDef* list,
+    uint8_t type,
+    uint8_t command,
+    uint16_t color,
+    uint32_t count,
+    const void* payload,
+    size_t payload_size
+) {
+    size_t size = sizeof(ILI9341_ListOpTypeDef) + ((payload_size + 3) & ~(size_t)3);
+    if (list->overflow || list->size - list->used < size) {
+        list->overflow = true;
+        return;
+    }
+
+    ILI9341_ListOpTypeDef op = {.type = type, .command = command, .color = color, .count = count};
+    memcpy(list->arena + list->used, &op, sizeof(op));
+    if (payload_size) memcpy(list->arena + list->used + sizeof(op), payload, payload_size);
+    list->used += size;
+    list->operations++;
+}
+
+/**
+ * @brief Number of pixels of a rectangle
+ * @param rect Pointer to the rectangle
+ * @return Area of the rectangle
+ */
+static inline uint32_t ILI9341_RectArea(const ILI9341_RectTypeDef* rect) {
+    return (uint32_t)(rect->x1 - rect->x0 + 1) * (rect->y1 - rect->y0 + 1);
+}
+
+/**
+ * @brief Compute the bounding box of two rectangles
+ * @param a Pointer to the first rectangle
+ * @param b Pointer to the second rectangle
+ * @return Smallest rectangle containing both
+ */
+static ILI9341_RectTypeDef ILI9341_RectUnion(const ILI9341_RectTypeDef* a, const ILI9341_RectTypeDef* b) {
+    return (ILI9341_RectTypeDef){
+        .x0 = a->x0 < b->x0 ? a->x0 : b->x0,
+        .y0 = a->y0 < b->y0 ? a->y0 : b->y0,
+        .x1 = a->x1 > b->x1 ? a->x1 : b->x1,
+        .y1 = a->y1 > b->y1 ? a->y1 : b->y1
+    };
+}
+
+/**
+ * @brief Add a changed area to the dirty rectangles of a framebuffer, merging it with the ones it is close to
+ * @param framebuffer Pointer to the framebuffer
+ * @param rect Changed area
+ * @note Two rectangles are merged when their bounding box has at most ILI9341_DIRTY_MERGE_PIXELS pixels that belong
+ * to neither, resending those is cheaper than another address window. When every slot is taken the rectangle is merged
+ * with the one whose bounding box grows the least.
+ */
+static void ILI9341_FramebufferAddDirty(ILI9341_FramebufferTypeDef* framebuffer, ILI9341_RectTypeDef rect) {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        uint8_t best = 0;
+        uint32_t best_growth = UINT32_MAX;
+        for (uint8_t i = 0; i < framebuffer->dirty_count; i++) {
+            ILI9341_RectTypeDef bounds = ILI9341_RectUnion(&framebuffer->dirty[i], &rect);
+            uint32_t area = ILI9341_RectArea(&framebuffer->dirty[i]) + ILI9341_RectArea(&rect);
+            uint32_t bounds_area = ILI9341_RectArea(&bounds);
+            uint32_t growth = bounds_area > area ? bounds_area - area : 0;
+            if (growth < best_growth) {
+                best = i;
+                best_growth = growth;
+            }
+        }
+
+        if (best_growth <= ILI9341_DIRTY_MERGE_PIXELS ||
+            (best_growth != UINT32_MAX && framebuffer->dirty_count == ILI9341_DIRTY_RECTS)) {
+            // take the rectangle out and add the union again, it may now be close to another one
+            rect = ILI9341_RectUnion(&framebuffer->dirty[best], &rect);
+            framebuffer->dirty[best] = framebuffer->dirty[--framebuffer->dirty_count];
+            merged = true;
+        }
+    }
+
+    framebuffer->dirty[framebuffer->dirty_count++] = rect;
+}
+
+/**
+ * @brief Move the pixels changed through the current address window to the dirty rectangles
+ * @param framebuffer Pointer to the framebuffer
+ */
+static void ILI9341_FramebufferCommit(ILI9341_FramebufferTypeDef* framebuffer) {
+    if (!framebuffer->changed_any) return;
+    framebuffer->changed_any = false;
+    ILI9341_FramebufferAddDirty(framebuffer, framebuffer->changed);
+}
+
+/**
+ * @brief Store a pixel at the current position of the framebuffer window and advance it, like the display would
+ * @param framebuffer Pointer to the framebuffer
+ * @param color 16-bit pixel color in RGB565 format
+ */
+static inline void ILI9341_FramebufferPut(ILI9341_FramebufferTypeDef* framebuffer, uint16_t color) {
+    uint16_t x = framebuffer->x;
+    uint16_t y = framebuffer->y;
+
+    if (x < framebuffer->width && y < framebuffer->height) {
+        uint16_t* pixel = &framebuffer->pixels[(uint32_t)y * framebuffer->width + x];
+        if (*pixel != color) {
+            *pixel = color;
+            ILI9341_RectTypeDef* changed = &framebuffer->changed;
+            if (!framebuffer->changed_any) {
+                *changed = (ILI9341_RectTypeDef){x, y, x, y};
+                framebuffer->changed_any = true;
+            } else {
+                if (x < changed->x0) changed->x0 = x;
+                if (x > changed->x1) changed->x1 = x;
+                if (y < changed->y0) changed->y0 = y;
+                if (y > changed->y1) changed->y1 = y;
+            }
+        }
+    }
+
+    if (x < framebuffer->window.x1) {
+        framebuffer->x = x + 1;
+    } else {
+        framebuffer->x = framebuffer->window.x0;
+        framebuffer->y = y < framebuffer->window.y1 ? y + 1 : framebuffer->window.y0;
+    }
+}
 
-static uint8_t ili9341_cmd_dma_buffer;
+/**
+ * @brief Assert the chip select of the panel through the transport
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_SelectPanel(ILI9341_HandleTypeDef* ili9341) {
+    #ifdef ILI9341_TRACE
+    if (ili9341->trace) ILI9341_TraceRecord(ili9341->trace, ILI9341_TRACE_SELECT, NULL, 0);
+    #endif
+    ili9341->transport->select(ili9341);
+}
 
 /**
  * @brief Select the ILI9341 display
  * @param ili9341 Pointer to ILI9341 handle structure
+ * @note With a framebuffer attached drawing stays in RAM, the panel is only selected by the first command of the call.
  */
 static void ILI9341_Select(ILI9341_HandleTypeDef* ili9341) {
-    HAL_GPIO_WritePin(ili9341->cs_port, ili9341->cs_pin, GPIO_PIN_RESET);
+    if (ili9341->display_list) {
+        ili9341->display_list->selects++;
+        return;
+    }
+    if (ili9341->framebuffer) return;
+    ILI9341_SelectPanel(ili9341);
 }
 
 void ILI9341_Deselect(ILI9341_HandleTypeDef* ili9341) {
-    HAL_GPIO_WritePin(ili9341->cs_port, ili9341->cs_pin, GPIO_PIN_SET);
+    if (ili9341->display_list) return;
+    ILI9341_FramebufferTypeDef* framebuffer = ili9341->framebuffer;
+    if (framebuffer) {
+        if (!framebuffer->panel_selected) return;
+        framebuffer->panel_selected = false;
+    }
+    #ifdef ILI9341_TRACE
+    if (ili9341->trace) ILI9341_TraceRecord(ili9341->trace, ILI9341_TRACE_DESELECT, NULL, 0);
+    #endif
+    ili9341->transport->deselect(ili9341);
 }
 
 /**
@@ -28,9 +237,21 @@ void ILI9341_Deselect(ILI9341_HandleTypeDef* ili9341) {
  * @param ili9341 Pointer to ILI9341 handle structure
  */
 static void ILI9341_Reset(ILI9341_HandleTypeDef* ili9341) {
-    HAL_GPIO_WritePin(ili9341->rst_port, ili9341->rst_pin, GPIO_PIN_RESET);
-    HAL_Delay(5);
-    HAL_GPIO_WritePin(ili9341->rst_port, ili9341->rst_pin, GPIO_PIN_SET);
+    ili9341->window_valid = false;
+    ili9341->window_writing = false;
+    #ifdef ILI9341_TRACE
+    if (ili9341->trace) ILI9341_TraceRecord(ili9341->trace, ILI9341_TRACE_RESET, NULL, 0);
+    #endif
+    ili9341->transport->reset(ili9341);
+}
+
+/**
+ * @brief Wait for the given number of milliseconds
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param ms Number of milliseconds to wait
+ */
+static void ILI9341_Delay(ILI9341_HandleTypeDef* ili9341, uint32_t ms) {
+    ili9341->transport->delay(ili9341, ms);
 }
 
 /**
@@ -39,8 +260,28 @@ static void ILI9341_Reset(ILI9341_HandleTypeDef* ili9341) {
  * @param cmd Command byte to write
  */
 static void ILI9341_WriteCommand(ILI9341_HandleTypeDef* ili9341, uint8_t cmd) {
-    HAL_GPIO_WritePin(ili9341->dc_port, ili9341->dc_pin, GPIO_PIN_RESET);
-    HAL_SPI_Transmit(ili9341->spi_handle, &cmd, sizeof(cmd), HAL_MAX_DELAY);
+    if (ili9341->display_list) {
+        ILI9341_ListAppend(ili9341->display_list, ILI9341_LIST_COMMAND, cmd, 0, 0, NULL, 0);
+        return;
+    }
+
+    // any command ends a memory write, SWRESET and MADCTL also change what the address registers refer to
+    ili9341->window_writing = false;
+    if (cmd == 0x01 /* SWRESET */ || cmd == 0x36 /* MADCTL */) ili9341->window_valid = false;
+
+    ILI9341_FramebufferTypeDef* framebuffer = ili9341->framebuffer;
+    if (framebuffer) {
+        framebuffer->writing = false;
+        if (!framebuffer->panel_selected) {
+            framebuffer->panel_selected = true;
+            ILI9341_SelectPanel(ili9341);
+        }
+    }
+
+    #ifdef ILI9341_TRACE
+    if (ili9341->trace) ILI9341_TraceRecord(ili9341->trace, ILI9341_TRACE_COMMAND, &cmd, 1);
+    #endif
+    ili9341->transport->write_command(ili9341, cmd);
 }
 
 /**
@@ -49,27 +290,274 @@ static void ILI9341_WriteCommand(ILI9341_HandleTypeDef* ili9341, uint8_t cmd) {
  * @param buff Pointer to the data buffer
  * @param buff_size Size of the data buffer
  */
-static void ILI9341_WriteData(ILI9341_HandleTypeDef* ili9341, uint8_t* buff, size_t buff_size) {
-    HAL_GPIO_WritePin(ili9341->dc_port, ili9341->dc_pin, GPIO_PIN_SET);
+static void ILI9341_WriteData(ILI9341_HandleTypeDef* ili9341, const uint8_t* buff, size_t buff_size) {
+    ILI9341_FramebufferTypeDef* framebuffer = ili9341->framebuffer;
+    if (framebuffer && framebuffer->writing) {
+        // pixel bytes, most significant byte first
+        for (size_t i = 0; i < buff_size; i++) {
+            if (framebuffer->byte_pending) ILI9341_FramebufferPut(framebuffer, framebuffer->byte << 8 | buff[i]);
+            framebuffer->byte = buff[i];
+            framebuffer->byte_pending = !framebuffer->byte_pending;
+        }
+        return;
+    }
+
+    if (ili9341->display_list) {
+        ILI9341_ListAppend(ili9341->display_list, ILI9341_LIST_DATA, 0, 0, buff_size, buff, buff_size);
+        return;
+    }
+
+    if (ili9341->window_writing) ili9341->window_written += buff_size;
+    #ifdef ILI9341_TRACE
+    if (ili9341->trace) ILI9341_TraceRecord(ili9341->trace, ILI9341_TRACE_DATA, buff, buff_size);
+    #endif
+    ili9341->transport->write_data(ili9341, buff, buff_size);
+}
+
+/**
+ * @brief Write pixels to the ILI9341 display
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param pixels Pointer to the pixels in RGB565 format
+ * @param count Number of pixels
+ */
+static void ILI9341_WritePixelData(ILI9341_HandleTypeDef* ili9341, const uint16_t* pixels, size_t count) {
+    if (ili9341->framebuffer) {
+        for (size_t i = 0; i < count; i++) { ILI9341_FramebufferPut(ili9341->framebuffer, pixels[i]); }
+        return;
+    }
+
+    if (ili9341->display_list) {
+        ILI9341_ListAppend(ili9341->display_list, ILI9341_LIST_PIXELS, 0, 0, count, pixels, count * sizeof(uint16_t));
+        return;
+    }
+
+    if (ili9341->window_writing) ili9341->window_written += count * sizeof(uint16_t);
+    #ifdef ILI9341_TRACE
+    if (ili9341->trace) ILI9341_TraceRecordPixels(ili9341->trace, pixels, count);
+    #endif
+    ili9341->transport->write_pixel_data(ili9341, pixels, count);
+}
+
+/**
+ * @brief Start writing pixels to the ILI9341 display without waiting for the transfer to complete
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param pixels Pointer to the pixels in RGB565 format, must stay untouched until the transfer completes
+ * @param count Number of pixels
+ */
+static void ILI9341_WritePixelDataAsync(ILI9341_HandleTypeDef* ili9341, const uint16_t* pixels, size_t count) {
+    if (ili9341->framebuffer) {
+        ILI9341_WritePixelData(ili9341, pixels, count);
+        return;
+    }
+
+    if (ili9341->display_list) {
+        ILI9341_ListAppend(ili9341->display_list, ILI9341_LIST_PIXELS, 0, 0, count, pixels, count * sizeof(uint16_t));
+        return;
+    }
+
+    if (ili9341->window_writing) ili9341->window_written += count * sizeof(uint16_t);
+    #ifdef ILI9341_TRACE
+    if (ili9341->trace) ILI9341_TraceRecordPixels(ili9341->trace, pixels, count);
+    #endif
+    ili9341->transport->write_pixel_data_async(ili9341, pixels, count);
+}
+
+/**
+ * @brief Write the same pixel color multiple times to the ILI9341 display
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param color 16-bit pixel color in RGB565 format
+ * @param count Number of pixels to write
+ */
+static void ILI9341_WritePixels(ILI9341_HandleTypeDef* ili9341, uint16_t color, uint32_t count) {
+    if (ili9341->framebuffer) {
+        for (uint32_t i = 0; i < count; i++) { ILI9341_FramebufferPut(ili9341->framebuffer, color); }
+        return;
+    }
+
+    if (ili9341->display_list) {
+        ILI9341_ListAppend(ili9341->display_list, ILI9341_LIST_FILL, 0, color, count, NULL, 0);
+        return;
+    }
+
+    if (ili9341->window_writing) ili9341->window_written += count * sizeof(uint16_t);
+    #ifdef ILI9341_TRACE
+    uint8_t data[] = {color >> 8, color & 0xFF};
+    if (ili9341->trace) ILI9341_TraceRecord(ili9341->trace, ILI9341_TRACE_FILL, data, count * sizeof(uint16_t));
+    #endif
+    ili9341->transport->write_pixels(ili9341, color, count);
+}
+
+/**
+ * @brief Read data from the ILI9341 display
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param buff Pointer to the receive buffer
+ * @param buff_size Number of bytes to read
+ * @note A read command must have been written, reads can't be recorded into display lists or framebuffers.
+ */
+static void ILI9341_ReadData(ILI9341_HandleTypeDef* ili9341, uint8_t* buff, size_t buff_size) {
+    ili9341->transport->read_data(ili9341, buff, buff_size);
+    #ifdef ILI9341_TRACE
+    if (ili9341->trace) ILI9341_TraceRecord(ili9341->trace, ILI9341_TRACE_READ, buff, buff_size);
+    #endif
+}
+
+/**
+ * @brief Take the next attached pixel buffer, the one returned is never the buffer of the transfer in flight
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @return Pointer to a buffer of pixel_buffer_size pixels
+ */
+static uint16_t* ILI9341_NextPixelBuffer(ILI9341_HandleTypeDef* ili9341) {
+    // with a single buffer the only way to get a free one is to wait for the transfer in flight
+    if (ili9341->pixel_buffer_count < 2) ILI9341_Wait(ili9341);
+
+    uint16_t* buffer = ili9341->pixel_buffers + (uint32_t)ili9341->pixel_buffer_next * ili9341->pixel_buffer_size;
+    ili9341->pixel_buffer_next = (ili9341->pixel_buffer_next + 1) % ili9341->pixel_buffer_count;
+    return buffer;
+}
+
+/**
+ * @brief Pixel writer, collects RGB565 pixels and sends them in buffer sized transfers
+ * @note Attached pixel buffers are taken lazily, so a flush never holds on to a buffer that is not going to be used.
+ */
+typedef struct {
+    ILI9341_HandleTypeDef* ili9341;
+    uint16_t* buffer;
+    uint16_t size;
+    uint16_t count;
+} ILI9341_PixelWriterTypeDef;
+
+/**
+ * @brief Start collecting pixels, into the attached pixel buffers if any or into the given fallback buffer
+ * @param writer Pointer to the pixel writer
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param fallback Buffer used when no pixel buffers are attached
+ * @param fallback_size Number of pixels in the fallback buffer
+ */
+static void ILI9341_PixelWriterBegin(
+    ILI9341_PixelWriterTypeDef* writer,
+    ILI9341_HandleTypeDef* ili9341,
+    uint16_t* fallback,
+    uint16_t fallback_size
+) {
+    writer->ili9341 = ili9341;
+    writer->count = 0;
+    if (ili9341->pixel_buffers) {
+        writer->buffer = NULL;
+        writer->size = ili9341->pixel_buffer_size;
+    } else {
+        writer->buffer = fallback;
+        writer->size = fallback_size;
+    }
+}
+
+/**
+ * @brief Send the collected pixels, asynchronously when pixel buffers are attached
+ * @param writer Pointer to the pixel writer
+ */
+static void ILI9341_PixelWriterFlush(ILI9341_PixelWriterTypeDef* writer) {
+    if (writer->count == 0) return;
+
+    ILI9341_HandleTypeDef* ili9341 = writer->ili9341;
+    if (ili9341->pixel_buffers) {
+        ILI9341_WritePixelDataAsync(ili9341, writer->buffer, writer->count);
+        writer->buffer = NULL;
+    } else {
+        ILI9341_WritePixelData(ili9341, writer->buffer, writer->count);
+    }
+    writer->count = 0;
+}
+
+/**
+ * @brief Add a pixel to the pixel writer, sending the buffer when it is full
+ * @param writer Pointer to the pixel writer
+ * @param color 16-bit pixel color in RGB565 format
+ */
+static inline void ILI9341_PixelWriterPut(ILI9341_PixelWriterTypeDef* writer, uint16_t color) {
+    if (!writer->buffer) writer->buffer = ILI9341_NextPixelBuffer(writer->ili9341);
+    writer->buffer[writer->count++] = color;
+    if (writer->count == writer->size) ILI9341_PixelWriterFlush(writer);
+}
 
-    // split data in small chunks because HAL can't send more then 64K at once
-    while (buff_size > 0) {
-        uint16_t chunk_size = buff_size > 32768 ? 32768 : buff_size;
+/**
+ * @brief Reserve room for pixels in the pixel writer, sending the collected ones first if the buffer is full
+ * @param writer Pointer to the pixel writer
+ * @param count Number of pixels wanted, set to the number reserved, between 1 and the number wanted
+ * @return Pointer to the reserved pixels, to be filled before the writer is used again
+ */
+static uint16_t* ILI9341_PixelWriterReserve(ILI9341_PixelWriterTypeDef* writer, uint16_t* count) {
+    if (writer->count == writer->size) ILI9341_PixelWriterFlush(writer);
+    if (!writer->buffer) writer->buffer = ILI9341_NextPixelBuffer(writer->ili9341);
+
+    uint16_t room = writer->size - writer->count;
+    if (*count > room) *count = room;
+    uint16_t* pixels = &writer->buffer[writer->count];
+    writer->count += *count;
+    return pixels;
+}
 
-        #ifdef ILI9341_ENABLE_DMA
-        while (!spi5Transferable) {}
-        spi5Transferable = false;
-        HAL_SPI_Transmit_DMA(ili9341->spi_handle, buff, chunk_size);
-        while (!spi5Transferable) {}
+/**
+ * @brief Send image pixels
+ * @param writer Pointer to the pixel writer
+ * @param data Pointer to the pixels in RGB565 format, with the 2 bytes swapped if ILI9341_SWAPPED_IMAGES is defined
+ * @param count Number of pixels
+ * @note Without attached pixel buffers the data is sent directly from the caller's memory.
+ */
+static void ILI9341_PixelWriterCopy(ILI9341_PixelWriterTypeDef* writer, const uint16_t* data, uint32_t count) {
+    if (!writer->ili9341->pixel_buffers) {
+        ILI9341_PixelWriterFlush(writer);
+        #ifdef ILI9341_SWAPPED_IMAGES
+        // swapped pixels are already in bus byte order
+        ILI9341_WriteData(writer->ili9341, (const uint8_t*)data, count * sizeof(uint16_t));
         #else
-        HAL_SPI_Transmit(ili9341->spi_handle, buff, chunk_size, HAL_MAX_DELAY);
+        ILI9341_WritePixelData(writer->ili9341, data, count);
         #endif
+        return;
+    }
 
-        buff += chunk_size;
-        buff_size -= chunk_size;
+    while (count > 0) {
+        if (!writer->buffer) writer->buffer = ILI9341_NextPixelBuffer(writer->ili9341);
+        uint16_t chunk_size = writer->size - writer->count;
+        if (chunk_size > count) chunk_size = count;
+        #ifdef ILI9341_SWAPPED_IMAGES
+        for (uint16_t i = 0; i < chunk_size; i++) {
+            writer->buffer[writer->count + i] = (data[i] >> 8) | (data[i] << 8);
+        }
+        #else
+        memcpy(&writer->buffer[writer->count], data, chunk_size * sizeof(uint16_t));
+        #endif
+        writer->count += chunk_size;
+        data += chunk_size;
+        count -= chunk_size;
+        if (writer->count == writer->size) ILI9341_PixelWriterFlush(writer);
     }
 }
 
+void ILI9341_AttachPixelBuffers(
+    ILI9341_HandleTypeDef* ili9341,
+    uint16_t* buffers,
+    uint16_t pixels_per_buffer,
+    uint8_t count
+) {
+    ILI9341_Wait(ili9341);
+
+    if (pixels_per_buffer == 0 || count == 0) buffers = NULL;
+
+    ili9341->pixel_buffers = buffers;
+    ili9341->pixel_buffer_size = buffers ? pixels_per_buffer : 0;
+    ili9341->pixel_buffer_count = buffers ? count : 0;
+    ili9341->pixel_buffer_next = 0;
+}
+
+void ILI9341_SetTransferCallback(ILI9341_HandleTypeDef* ili9341, ILI9341_TransferCallback callback, void* arg) {
+    ILI9341_Wait(ili9341);
+    ili9341->transfer_callback = callback;
+    ili9341->transfer_callback_arg = arg;
+}
+
+void ILI9341_Wait(ILI9341_HandleTypeDef* ili9341) {
+    ili9341->transport->wait(ili9341);
+}
+
 /**
  * @brief Set the address window for subsequent pixel data
  * @param ili9341 Pointer to ILI9341 handle structure
@@ -77,6 +565,9 @@ static void ILI9341_WriteData(ILI9341_HandleTypeDef* ili9341, uint8_t* buff, siz
  * @param y0 Y coordinate of the top-left corner of the window
  * @param x1 X coordinate of the bottom-right corner of the window
  * @param y1 Y coordinate of the bottom-right corner of the window
+ * @note The window last sent to the display is cached in the handle. CASET and RASET are only sent when the cached
+ * window can't hold the requested one, and a write that starts where the previous one stopped is continued with
+ * RAMWRC without touching the window. Callers must write exactly (x1 - x0 + 1) * (y1 - y0 + 1) pixels.
  */
 static void ILI9341_SetAddressWindow(
     ILI9341_HandleTypeDef* ili9341,
@@ -85,51 +576,465 @@ static void ILI9341_SetAddressWindow(
     uint16_t x1,
     uint16_t y1
 ) {
-    // column address set
-    ILI9341_WriteCommand(ili9341, 0x2A);  // CASET
-    {
-        uint8_t data[] = {(x0 >> 8) & 0xFF, x0 & 0xFF, (x1 >> 8) & 0xFF, x1 & 0xFF};
-        ILI9341_WriteData(ili9341, data, sizeof(data));
+    ILI9341_FramebufferTypeDef* framebuffer = ili9341->framebuffer;
+    if (framebuffer) {
+        ILI9341_FramebufferCommit(framebuffer);
+        framebuffer->window = (ILI9341_RectTypeDef){x0, y0, x1, y1};
+        framebuffer->x = x0;
+        framebuffer->y = y0;
+        framebuffer->writing = true;
+        framebuffer->byte_pending = false;
+        return;
     }
 
-    // row address set
-    ILI9341_WriteCommand(ili9341, 0x2B);  // RASET
-    {
-        uint8_t data[] = {(y0 >> 8) & 0xFF, y0 & 0xFF, (y1 >> 8) & 0xFF, y1 & 0xFF};
-        ILI9341_WriteData(ili9341, data, sizeof(data));
+    if (ili9341->display_list) {
+        uint16_t window[] = {x0, y0, x1, y1};
+        ILI9341_ListAppend(ili9341->display_list, ILI9341_LIST_WINDOW, 0, 0, 0, window, sizeof(window));
+        return;
+    }
+
+    bool single_row = y0 == y1;
+
+    if (ili9341->window_valid && ili9341->window_writing) {
+        // position of the memory pointer after the pixels written so far
+        uint16_t window_w = ili9341->window_x1 - ili9341->window_x0 + 1;
+        uint16_t window_h = ili9341->window_y1 - ili9341->window_y0 + 1;
+        uint32_t written = ili9341->window_written / sizeof(uint16_t);
+        uint16_t pointer_x = ili9341->window_x0 + written % window_w;
+        uint16_t pointer_y = ili9341->window_y0 + (written / window_w) % window_h;
+
+        bool contiguous = x0 == pointer_x && y0 == pointer_y &&
+                          ((single_row && x1 <= ili9341->window_x1) ||
+                           (x0 == ili9341->window_x0 && x1 == ili9341->window_x1 && y1 <= ili9341->window_y1));
+        if (contiguous) {
+            ILI9341_WriteCommand(ili9341, 0x3C);  // RAMWRC
+            ili9341->window_writing = true;
+            ili9341->stats.window_commands_saved += 2;
+            ili9341->stats.window_bytes_saved += 8;
+            ili9341->stats.window_continues++;
+            return;
+        }
+    }
+
+    // a single row is written left to right, any column window starting at x0 and reaching x1 holds it, a new one
+    // is opened up to the right edge so that the following pixels of the row can be continued
+    bool columns_hold = ili9341->window_valid && ili9341->window_x0 == x0 &&
+                        (single_row ? ili9341->window_x1 >= x1 : ili9341->window_x1 == x1);
+    bool rows_hold = ili9341->window_valid && ili9341->window_y0 == y0 && ili9341->window_y1 >= y1 &&
+                     (single_row || columns_hold);
+
+    if (!columns_hold) {
+        if (single_row && x1 < ili9341->width - 1) x1 = ili9341->width - 1;
+
+        // column address set
+        ILI9341_WriteCommand(ili9341, 0x2A);  // CASET
+        {
+            uint8_t data[] = {(x0 >> 8) & 0xFF, x0 & 0xFF, (x1 >> 8) & 0xFF, x1 & 0xFF};
+            ILI9341_WriteData(ili9341, data, sizeof(data));
+        }
+        ili9341->window_x0 = x0;
+        ili9341->window_x1 = x1;
+    } else {
+        ili9341->stats.window_commands_saved++;
+        ili9341->stats.window_bytes_saved += 4;
     }
 
+    if (!rows_hold) {
+        // row address set
+        ILI9341_WriteCommand(ili9341, 0x2B);  // RASET
+        {
+            uint8_t data[] = {(y0 >> 8) & 0xFF, y0 & 0xFF, (y1 >> 8) & 0xFF, y1 & 0xFF};
+            ILI9341_WriteData(ili9341, data, sizeof(data));
+        }
+        ili9341->window_y0 = y0;
+        ili9341->window_y1 = y1;
+    } else {
+        ili9341->stats.window_commands_saved++;
+        ili9341->stats.window_bytes_saved += 4;
+    }
+
+    ili9341->window_valid = true;
+
     // write to RAM
     ILI9341_WriteCommand(ili9341, 0x2C);  // RAMWR
+    ili9341->window_writing = true;
+    ili9341->window_written = 0;
+}
+
+/**
+ * @brief Read the operation at the given offset of a display list
+ * @param list Pointer to the display list
+ * @param offset Offset of the operation, updated to the offset of the next one
+ * @param op Pointer to the header receiving the operation
+ * @return Pointer to the payload of the operation
+ */
+static const uint8_t* ILI9341_ListRead(
+    const ILI9341_DisplayListTypeDef* list,
+    size_t* offset,
+    ILI9341_ListOpTypeDef* op
+) {
+    memcpy(op, list->arena + *offset, sizeof(*op));
+    const uint8_t* payload = list->arena + *offset + sizeof(*op);
+
+    size_t payload_size = 0;
+    if (op->type == ILI9341_LIST_WINDOW) payload_size = 4 * sizeof(uint16_t);
+    if (op->type == ILI9341_LIST_PIXELS) payload_size = op->count * sizeof(uint16_t);
+    if (op->type == ILI9341_LIST_DATA) payload_size = op->count;
+    *offset += sizeof(*op) + ((payload_size + 3) & ~(size_t)3);
+
+    return payload;
+}
+
+/**
+ * @brief Merge a window into another one if the two together form a rectangle written in address order
+ * @param window Window to grow, x0, y0, x1, y1
+ * @param next Window following it
+ * @return true if next was merged into window
+ */
+static bool ILI9341_ListMergeWindow(uint16_t* window, const uint16_t* next) {
+    // next rows below, same columns
+    if (next[0] == window[0] && next[2] == window[2] && next[1] == window[3] + 1) {
+        window[3] = next[3];
+        return true;
+    }
+
+    // next pixels on the right of a single row
+    if (window[1] == window[3] && next[1] == window[1] && next[3] == window[3] && next[0] == window[2] + 1) {
+        window[2] = next[2];
+        return true;
+    }
+
+    return false;
 }
 
-ILI9341_HandleTypeDef ILI9341_Init(
-    SPI_HandleTypeDef* spi_handle,
-    GPIO_TypeDef* cs_port,
-    uint16_t cs_pin,
-    GPIO_TypeDef* dc_port,
-    uint16_t dc_pin,
-    GPIO_TypeDef* rst_port,
-    uint16_t rst_pin,
-    uint8_t rotation,
-    uint16_t width,
-    uint16_t height
+void ILI9341_AttachFramebuffer(
+    ILI9341_HandleTypeDef* ili9341,
+    ILI9341_FramebufferTypeDef* framebuffer,
+    uint16_t* pixels
+) {
+    ILI9341_Wait(ili9341);
+
+    if (framebuffer) {
+        *framebuffer = (ILI9341_FramebufferTypeDef){
+            .pixels = pixels,
+            .width = ili9341->width,
+            .height = ili9341->height
+        };
+    }
+
+    ili9341->framebuffer = framebuffer;
+}
+
+uint32_t ILI9341_Flush(ILI9341_HandleTypeDef* ili9341) {
+    ILI9341_FramebufferTypeDef* framebuffer = ili9341->framebuffer;
+    if (!framebuffer) return 0;
+
+    ILI9341_FramebufferCommit(framebuffer);
+    if (framebuffer->dirty_count == 0) return 0;
+
+    // send through the regular path, the framebuffer would take the pixels back otherwise
+    ili9341->framebuffer = NULL;
+    uint32_t sent = 0;
+
+    ILI9341_Select(ili9341);
+    for (uint8_t i = 0; i < framebuffer->dirty_count; i++) {
+        const ILI9341_RectTypeDef* rect = &framebuffer->dirty[i];
+        uint16_t width = rect->x1 - rect->x0 + 1;
+        const uint16_t* row = &framebuffer->pixels[(uint32_t)rect->y0 * framebuffer->width + rect->x0];
+
+        ILI9341_SetAddressWindow(ili9341, rect->x0, rect->y0, rect->x1, rect->y1);
+        if (width == framebuffer->width) {
+            // full rows are contiguous in the framebuffer
+            ILI9341_WritePixelDataAsync(ili9341, row, (uint32_t)width * (rect->y1 - rect->y0 + 1));
+        } else {
+            for (uint16_t y = rect->y0; y <= rect->y1; y++) {
+                ILI9341_WritePixelDataAsync(ili9341, row, width);
+                row += framebuffer->width;
+            }
+        }
+        sent += ILI9341_RectArea(rect);
+    }
+    ILI9341_Deselect(ili9341);
+
+    framebuffer->dirty_count = 0;
+    ili9341->framebuffer = framebuffer;
+    return sent;
+}
+
+void ILI9341_BeginDisplayList(
+    ILI9341_HandleTypeDef* ili9341,
+    ILI9341_DisplayListTypeDef* list,
+    void* arena,
+    size_t size
+) {
+    // the arena may still be the source of a replay in flight
+    ILI9341_Wait(ili9341);
+
+    // operations are 4 byte aligned so pixel payloads can be sent from the arena directly
+    uint8_t* aligned = (uint8_t*)(((uintptr_t)arena + 3) & ~(uintptr_t)3);
+    size_t skipped = aligned - (uint8_t*)arena;
+
+    list->arena = aligned;
+    list->size = size > skipped ? size - skipped : 0;
+    list->used = 0;
+    list->operations = 0;
+    list->selects = 0;
+    list->overflow = false;
+
+    ili9341->display_list = list;
+}
+
+bool ILI9341_EndDisplayList(ILI9341_HandleTypeDef* ili9341) {
+    ILI9341_DisplayListTypeDef* list = ili9341->display_list;
+    ili9341->display_list = NULL;
+    return list && !list->overflow;
+}
+
+void ILI9341_ReplayDisplayList(
+    ILI9341_HandleTypeDef* ili9341,
+    const ILI9341_DisplayListTypeDef* list,
+    ILI9341_DisplayListStatsTypeDef* stats
 ) {
-    ILI9341_HandleTypeDef ili9341_instance = {
-        .spi_handle = spi_handle,
-        .cs_port = cs_port,
-        .cs_pin = cs_pin,
-        .dc_port = dc_port,
-        .dc_pin = dc_pin,
-        .rst_port = rst_port,
-        .rst_pin = rst_pin,
-        .rotation = rotation,
-        .width = width,
-        .height = height
+    ILI9341_DisplayListStatsTypeDef replay = {
+        .operations = list->operations,
+        .selects_saved = list->selects > 1 ? list->selects - 1 : 0
     };
+    uint32_t window_commands_saved = ili9341->stats.window_commands_saved;
+    uint32_t window_bytes_saved = ili9341->stats.window_bytes_saved;
+
+    // a window is only sent once pixels are written to it
+    uint16_t window[4];
+    bool window_pending = false;
+
+    ILI9341_Select(ili9341);
+
+    size_t offset = 0;
+    while (offset < list->used) {
+        ILI9341_ListOpTypeDef op;
+        const uint8_t* payload = ILI9341_ListRead(list, &offset, &op);
+
+        switch (op.type) {
+            case ILI9341_LIST_WINDOW:
+                if (window_pending) replay.windows_dropped++;
+                memcpy(window, payload, sizeof(window));
+                window_pending = true;
+                break;
+
+            case ILI9341_LIST_FILL: {
+                // merge the following window and fill pairs of the same color as long as the windows adjoin
+                uint32_t count = op.count;
+                while (window_pending && offset < list->used) {
+                    size_t next_offset = offset;
+                    ILI9341_ListOpTypeDef next_window, next_fill;
+                    const uint8_t* next_payload = ILI9341_ListRead(list, &next_offset, &next_window);
+                    if (next_window.type != ILI9341_LIST_WINDOW || next_offset >= list->used) break;
+                    ILI9341_ListRead(list, &next_offset, &next_fill);
+                    if (next_fill.type != ILI9341_LIST_FILL || next_fill.color != op.color) break;
+
+                    uint16_t next[4];
+                    memcpy(next, next_payload, sizeof(next));
+                    if (!ILI9341_ListMergeWindow(window, next)) break;
+
+                    count += next_fill.count;
+                    offset = next_offset;
+                    replay.fills_merged++;
+                }
+
+                if (window_pending) ILI9341_SetAddressWindow(ili9341, window[0], window[1], window[2], window[3]);
+                window_pending = false;
+                ILI9341_WritePixels(ili9341, op.color, count);
+                break;
+            }
+
+            case ILI9341_LIST_PIXELS:
+                if (window_pending) ILI9341_SetAddressWindow(ili9341, window[0], window[1], window[2], window[3]);
+                window_pending = false;
+                ILI9341_WritePixelDataAsync(ili9341, (const uint16_t*)payload, op.count);
+                break;
+
+            case ILI9341_LIST_COMMAND:
+                // commands are only recorded outside of memory writes, a window without pixels is useless
+                if (window_pending) replay.windows_dropped++;
+                window_pending = false;
+                ILI9341_WriteCommand(ili9341, op.command);
+                break;
+
+            case ILI9341_LIST_DATA:
+                if (window_pending) ILI9341_SetAddressWindow(ili9341, window[0], window[1], window[2], window[3]);
+                window_pending = false;
+                ILI9341_WriteData(ili9341, payload, op.count);
+                break;
+        }
+    }
+    if (window_pending) replay.windows_dropped++;
+
+    ILI9341_Deselect(ili9341);
 
-    ILI9341_HandleTypeDef* ili9341 = &ili9341_instance;
+    // every merged or dropped window would have been a CASET, a RASET and a RAMWR with 8 parameter bytes
+    replay.commands_saved = (replay.fills_merged + replay.windows_dropped) * 3;
+    replay.bytes_saved = (replay.fills_merged + replay.windows_dropped) * 11;
+    replay.commands_saved += ili9341->stats.window_commands_saved - window_commands_saved;
+    replay.bytes_saved += ili9341->stats.window_bytes_saved - window_bytes_saved;
 
+    if (stats) *stats = replay;
+}
+
+/**
+ * @brief Strip being rendered, the lines y0 to y0 + lines - 1 of the display
+ */
+typedef struct {
+    uint16_t* pixels;
+    uint16_t width;
+    uint16_t y0;
+    uint16_t lines;
+    /** Address window and position of the next pixel written */
+    ILI9341_RectTypeDef window;
+    uint16_t x;
+    uint16_t y;
+} ILI9341_StripTypeDef;
+
+/**
+ * @brief Write pixels through the address window of a strip like the display would, keeping those on its lines
+ * @param strip Pointer to the strip
+ * @param pixels Pointer to the pixels in RGB565 format, NULL to write color
+ * @param color 16-bit pixel color in RGB565 format, used when pixels is NULL
+ * @param count Number of pixels
+ * @note Rows of the window above the strip are skipped at once, and the write stops as soon as the rest of it is
+ * below the strip, so operations outside of the strip cost almost nothing.
+ */
+static void ILI9341_StripWrite(ILI9341_StripTypeDef* strip, const uint16_t* pixels, uint16_t color, uint32_t count) {
+    const ILI9341_RectTypeDef* window = &strip->window;
+    uint32_t window_width = window->x1 - window->x0 + 1;
+    uint32_t strip_y1 = strip->y0 + strip->lines - 1;
+
+    while (count > 0) {
+        uint32_t x = strip->x;
+        uint32_t y = strip->y;
+        uint32_t run = window->x1 - x + 1;
+        uint32_t skip = 0;
+
+        if (y > strip_y1) {
+            // nothing left on the strip until the window wraps around
+            uint32_t left = run + (window->y1 - y) * window_width;
+            if (count <= left) return;
+            skip = left;
+        } else if (y < strip->y0 && x == window->x0 && count >= window_width) {
+            // whole rows above the strip
+            uint32_t rows = (strip->y0 < window->y1 + 1u ? strip->y0 : window->y1 + 1u) - y;
+            if (rows > count / window_width) rows = count / window_width;
+            skip = rows * window_width;
+        }
+
+        if (skip) {
+            y += skip / window_width + (x + skip % window_width > window->x1);
+            x = window->x0 + (x - window->x0 + skip) % window_width;
+            strip->x = x;
+            strip->y = y > window->y1 ? window->y0 : y;
+            if (pixels) pixels += skip;
+            count -= skip;
+            continue;
+        }
+
+        if (run > count) run = count;
+        if (y >= strip->y0 && x < strip->width) {
+            uint32_t visible = x + run > strip->width ? strip->width - x : run;
+            uint16_t* dst = &strip->pixels[(y - strip->y0) * strip->width + x];
+            if (pixels) {
+                memcpy(dst, pixels, visible * sizeof(uint16_t));
+            } else {
+                for (uint32_t i = 0; i < visible; i++) { dst[i] = color; }
+            }
+        }
+
+        if (pixels) pixels += run;
+        count -= run;
+        if (x + run > window->x1) {
+            strip->x = window->x0;
+            strip->y = y < window->y1 ? y + 1 : window->y0;
+        } else {
+            strip->x = x + run;
+        }
+    }
+}
+
+void ILI9341_RenderStrips(
+    ILI9341_HandleTypeDef* ili9341,
+    const ILI9341_DisplayListTypeDef* list,
+    uint16_t* buffers,
+    uint16_t lines,
+    uint8_t count,
+    uint16_t background
+) {
+    if (lines == 0 || count == 0) return;
+
+    uint32_t strip_size = (uint32_t)ili9341->width * lines;
+    uint8_t next = 0;
+
+    ILI9341_Select(ili9341);
+    for (uint16_t y0 = 0; y0 < ili9341->height; y0 += lines) {
+        // with a single strip the only way to get a free one is to wait for the transfer in flight
+        if (count < 2) ILI9341_Wait(ili9341);
+
+        ILI9341_StripTypeDef strip = {
+            .pixels = buffers + next * strip_size,
+            .width = ili9341->width,
+            .y0 = y0,
+            .lines = ili9341->height - y0 < lines ? ili9341->height - y0 : lines
+        };
+        next = (next + 1) % count;
+
+        uint32_t strip_pixels = (uint32_t)strip.width * strip.lines;
+        for (uint32_t i = 0; i < strip_pixels; i++) { strip.pixels[i] = background; }
+
+        // pixels are only written after an address window and until the next command, as on the display
+        bool writing = false;
+        bool byte_pending = false;
+        uint8_t byte = 0;
+
+        size_t offset = 0;
+        while (offset < list->used) {
+            ILI9341_ListOpTypeDef op;
+            const uint8_t* payload = ILI9341_ListRead(list, &offset, &op);
+
+            switch (op.type) {
+                case ILI9341_LIST_WINDOW:
+                    memcpy(&strip.window, payload, sizeof(strip.window));
+                    writing = strip.window.x0 <= strip.window.x1 && strip.window.y0 <= strip.window.y1;
+                    strip.x = strip.window.x0;
+                    strip.y = strip.window.y0;
+                    byte_pending = false;
+                    break;
+
+                case ILI9341_LIST_FILL:
+                    if (writing) ILI9341_StripWrite(&strip, NULL, op.color, op.count);
+                    break;
+
+                case ILI9341_LIST_PIXELS:
+                    if (writing) ILI9341_StripWrite(&strip, (const uint16_t*)payload, 0, op.count);
+                    break;
+
+                case ILI9341_LIST_DATA:
+                    // pixel bytes, most significant byte first
+                    for (uint32_t j = 0; writing && j < op.count; j++) {
+                        if (byte_pending) ILI9341_StripWrite(&strip, NULL, byte << 8 | payload[j], 1);
+                        byte = payload[j];
+                        byte_pending = !byte_pending;
+                    }
+                    break;
+
+                case ILI9341_LIST_COMMAND:
+                    writing = false;
+                    break;
+            }
+        }
+
+        ILI9341_SetAddressWindow(ili9341, 0, y0, strip.width - 1, y0 + strip.lines - 1);
+        ILI9341_WritePixelDataAsync(ili9341, strip.pixels, strip_pixels);
+    }
+    ILI9341_Deselect(ili9341);
+}
+
+void ILI9341_InitDisplay(ILI9341_HandleTypeDef* ili9341) {
     ILI9341_Select(ili9341);
     ILI9341_Reset(ili9341);
 
@@ -137,7 +1042,7 @@ ILI9341_HandleTypeDef ILI9341_Init(
 
     // SOFTWARE RESET
     ILI9341_WriteCommand(ili9341, 0x01);
-    HAL_Delay(1000);
+    ILI9341_Delay(ili9341, 1000);
 
     // POWER CONTROL A
     ILI9341_WriteCommand(ili9341, 0xCB);
@@ -267,7 +1172,7 @@ ILI9341_HandleTypeDef ILI9341_Init(
 
     // EXIT SLEEP
     ILI9341_WriteCommand(ili9341, 0x11);
-    HAL_Delay(120);
+    ILI9341_Delay(ili9341, 120);
 
     // TURN ON DISPLAY
     ILI9341_WriteCommand(ili9341, 0x29);
@@ -305,8 +1210,6 @@ ILI9341_HandleTypeDef ILI9341_Init(
     }
 
     ILI9341_Deselect(ili9341);
-
-    return ili9341_instance;
 }
 
 void ILI9341_SetOrientation(ILI9341_HandleTypeDef* ili9341, uint8_t rotation, uint8_t scrollBit) {
@@ -362,24 +1265,137 @@ void ILI9341_SetOrientation(ILI9341_HandleTypeDef* ili9341, uint8_t rotation, ui
 }
 
 /**
- * @brief Draw a pixel at specified coordinates without selecting/deselecting the display
+ * @brief Get the rectangle drawing is clipped to
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @return The last pushed clip rectangle within the display, the whole display if none is pushed, x0 > x1 if empty
+ */
+static inline ILI9341_RectTypeDef ILI9341_ClipRect(const ILI9341_HandleTypeDef* ili9341) {
+    ILI9341_RectTypeDef clip = {0, 0, ili9341->width - 1, ili9341->height - 1};
+    if (ili9341->clip_depth == 0) return clip;
+
+    // the display may have been rotated since the rectangle was pushed
+    const ILI9341_RectTypeDef* top = &ili9341->clip_stack[ili9341->clip_depth - 1];
+    clip.x0 = top->x0;
+    clip.y0 = top->y0;
+    if (top->x1 < clip.x1) clip.x1 = top->x1;
+    if (top->y1 < clip.y1) clip.y1 = top->y1;
+    return clip;
+}
+
+/**
+ * @brief Get the part of a box inside the clip rectangle
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x X coordinate of the top-left corner of the box
+ * @param y Y coordinate of the top-left corner of the box
+ * @param w Width of the box in pixels
+ * @param h Height of the box in pixels
+ * @param visible Pointer to the visible part, corners included, relative to the top-left corner of the box, can be
+ * NULL to only test the box
+ * @return false if the box is entirely outside of the clip rectangle
+ */
+static bool ILI9341_ClipBox(
+    const ILI9341_HandleTypeDef* ili9341,
+    int32_t x,
+    int32_t y,
+    int32_t w,
+    int32_t h,
+    ILI9341_RectTypeDef* visible
+) {
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    int32_t x0 = clip.x0 > x ? clip.x0 - x : 0;
+    int32_t y0 = clip.y0 > y ? clip.y0 - y : 0;
+    int32_t x1 = clip.x1 < x + w - 1 ? clip.x1 - x : w - 1;
+    int32_t y1 = clip.y1 < y + h - 1 ? clip.y1 - y : h - 1;
+    if (x0 > x1 || y0 > y1) return false;
+
+    if (visible) *visible = (ILI9341_RectTypeDef){x0, y0, x1, y1};
+    return true;
+}
+
+bool ILI9341_PushClipRect(ILI9341_HandleTypeDef* ili9341, int16_t x, int16_t y, int16_t w, int16_t h) {
+    if (ili9341->clip_depth == ILI9341_CLIP_STACK_DEPTH) return false;
+
+    ILI9341_RectTypeDef visible;
+    ILI9341_RectTypeDef clip = {1, 1, 0, 0};
+    if (w > 0 && h > 0 && ILI9341_ClipBox(ili9341, x, y, w, h, &visible)) {
+        clip = (ILI9341_RectTypeDef){x + visible.x0, y + visible.y0, x + visible.x1, y + visible.y1};
+    }
+
+    ili9341->clip_stack[ili9341->clip_depth++] = clip;
+    return true;
+}
+
+void ILI9341_PopClipRect(ILI9341_HandleTypeDef* ili9341) {
+    if (ili9341->clip_depth > 0) ili9341->clip_depth--;
+}
+
+/**
+ * @brief Write a pixel known to be inside the clip rectangle without selecting/deselecting the display
  * @param ili9341 Pointer to ILI9341 handle structure
  * @param x X coordinate of the pixel
  * @param y Y coordinate of the pixel
  * @param color 16-bit pixel color in RGB565 format
  */
-static void ILI9341_DrawPixelFast(ILI9341_HandleTypeDef* ili9341, int16_t x, int16_t y, uint16_t color) {
-    if (x < 0 || y < 0 || x >= ili9341->width || y >= ili9341->height) return;
+static void ILI9341_WritePixelFast(ILI9341_HandleTypeDef* ili9341, int32_t x, int32_t y, uint16_t color) {
+    ILI9341_SetAddressWindow(ili9341, x, y, x, y);
 
-    ILI9341_SetAddressWindow(ili9341, x, y, x + 1, y + 1);
+    // a single pixel is sent as 2 parameter bytes, cheaper than switching the bus to pixel frames and back
     uint8_t data[] = {color >> 8, color & 0xFF};
     ILI9341_WriteData(ili9341, data, sizeof(data));
 }
 
-void ILI9341_DrawPixel(ILI9341_HandleTypeDef* ili9341, int16_t x, int16_t y, uint16_t color) {
-    ILI9341_Select(ili9341);
-    ILI9341_DrawPixelFast(ili9341, x, y, color);
-    ILI9341_Deselect(ili9341);
+/**
+ * @brief Draw a pixel at specified coordinates without selecting/deselecting the display
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x X coordinate of the pixel
+ * @param y Y coordinate of the pixel
+ * @param color 16-bit pixel color in RGB565 format
+ */
+static void ILI9341_DrawPixelFast(ILI9341_HandleTypeDef* ili9341, int16_t x, int16_t y, uint16_t color) {
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    if (x < clip.x0 || y < clip.y0 || x > clip.x1 || y > clip.y1) return;
+
+    ILI9341_WritePixelFast(ili9341, x, y, color);
+}
+
+void ILI9341_DrawPixel(ILI9341_HandleTypeDef* ili9341, int16_t x, int16_t y, uint16_t color) {
+    ILI9341_Select(ili9341);
+    ILI9341_DrawPixelFast(ili9341, x, y, color);
+    ILI9341_Deselect(ili9341);
+}
+
+/**
+ * @brief Fill a span (a rectangle given by its corners, included) without selecting/deselecting the display
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x0 X coordinate of the top-left corner
+ * @param y0 Y coordinate of the top-left corner
+ * @param x1 X coordinate of the bottom-right corner
+ * @param y1 Y coordinate of the bottom-right corner
+ * @param color 16-bit fill color in RGB565 format
+ * @note The span is clipped to the clip rectangle, coordinates are 32-bit so spans of large shapes do not overflow.
+ */
+static void ILI9341_FillSpanFast(
+    ILI9341_HandleTypeDef* ili9341,
+    int32_t x0,
+    int32_t y0,
+    int32_t x1,
+    int32_t y1,
+    uint16_t color
+) {
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    if (x0 < clip.x0) x0 = clip.x0;
+    if (y0 < clip.y0) y0 = clip.y0;
+    if (x1 > clip.x1) x1 = clip.x1;
+    if (y1 > clip.y1) y1 = clip.y1;
+    if (x0 > x1 || y0 > y1) return;
+
+    if (x0 == x1 && y0 == y1) {
+        ILI9341_WritePixelFast(ili9341, x0, y0, color);
+        return;
+    }
+
+    ILI9341_SetAddressWindow(ili9341, x0, y0, x1, y1);
+    ILI9341_WritePixels(ili9341, color, (uint32_t)(x1 - x0 + 1) * (y1 - y0 + 1));
 }
 
 /**
@@ -409,35 +1425,44 @@ static void ILI9341_FillRectangleFast(
         y -= h - 1;
     }
 
-    if (x >= ili9341->width || y >= ili9341->height || w == 0 || h == 0) return;
-
-    if (x < 0) {
-        w += x;
-        x = 0;
-        if (w <= 0) return;
-    }
-
-    if (y < 0) {
-        h += y;
-        y = 0;
-        if (h <= 0) return;
-    }
-
-    if ((x + w - 1) >= ili9341->width) w = ili9341->width - x;
-    if ((y + h - 1) >= ili9341->height) h = ili9341->height - y;
-
-    ILI9341_SetAddressWindow(ili9341, x, y, x + w - 1, y + h - 1);
-
-    uint8_t buffer[ILI9341_FILL_RECT_BUFFER_SIZE * 2];
+    if (w == 0 || h == 0) return;
 
-    color = (color >> 8) | (color << 8);
-    for (uint32_t i = 0; i < ILI9341_FILL_RECT_BUFFER_SIZE; i++) { *(uint16_t*)&buffer[i * 2] = color; }
+    ILI9341_FillSpanFast(ili9341, x, y, (int32_t)x + w - 1, (int32_t)y + h - 1, color);
+}
 
-    uint32_t total_size = w * h;
-    while (total_size > 0) {
-        uint16_t chunk_size = (total_size > ILI9341_FILL_RECT_BUFFER_SIZE) ? ILI9341_FILL_RECT_BUFFER_SIZE : total_size;
-        ILI9341_WriteData(ili9341, buffer, chunk_size * 2);
-        total_size -= chunk_size;
+/**
+ * @brief Fill the 4 mirror images of a span around a center, each pixel once
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param xc X coordinate of the center
+ * @param yc Y coordinate of the center
+ * @param dx0 First horizontal offset of the span from the center, >= 0
+ * @param dx1 Last horizontal offset of the span from the center, >= dx0
+ * @param dy0 First vertical offset of the span from the center, >= 0
+ * @param dy1 Last vertical offset of the span from the center, >= dy0
+ * @param color 16-bit fill color in RGB565 format
+ * @note Images of a span starting at offset 0 touch each other, they are filled as a single span.
+ */
+static void ILI9341_FillMirroredFast(
+    ILI9341_HandleTypeDef* ili9341,
+    int32_t xc,
+    int32_t yc,
+    int32_t dx0,
+    int32_t dx1,
+    int32_t dy0,
+    int32_t dy1,
+    uint16_t color
+) {
+    int32_t y0 = dy0 == 0 ? yc - dy1 : yc + dy0;
+    if (dx0 == 0) {
+        ILI9341_FillSpanFast(ili9341, xc - dx1, y0, xc + dx1, yc + dy1, color);
+        if (dy0 != 0) ILI9341_FillSpanFast(ili9341, xc - dx1, yc - dy1, xc + dx1, yc - dy0, color);
+    } else {
+        ILI9341_FillSpanFast(ili9341, xc + dx0, y0, xc + dx1, yc + dy1, color);
+        ILI9341_FillSpanFast(ili9341, xc - dx1, y0, xc - dx0, yc + dy1, color);
+        if (dy0 != 0) {
+            ILI9341_FillSpanFast(ili9341, xc + dx0, yc - dy1, xc + dx1, yc - dy0, color);
+            ILI9341_FillSpanFast(ili9341, xc - dx1, yc - dy1, xc - dx0, yc - dy0, color);
+        }
     }
 }
 
@@ -454,118 +1479,371 @@ void ILI9341_FillScreen(ILI9341_HandleTypeDef* ili9341, uint16_t color) {
 }
 
 /**
- * @brief Write a character at specified coordinates without selecting/deselecting the display
- * @param ili9341 Pointer to ILI9341 handle structure
- * @param x X coordinate of the top-left of the character
- * @param y Y coordinate of the top-left of the character
- * @param ch ASCII character to write
- * @param font Font definition to use for rendering the character
- * @param color 16-bit character color in RGB565 format
- * @param bgcolor 16-bit background color in RGB565 format
+ * @brief Get bits of a glyph, most significant bit first
+ * @param glyph Pointer to the glyph bits
+ * @param bit_index Index of the first bit
+ * @param count Number of bits wanted, from 1 to 32
+ * @return The bits wanted at the most significant end, the bits after them are undefined
+ * @note The glyph is read a word at a time, a word holding none of the bits wanted is never read.
  */
-static void ILI9341_WriteChar(
-    ILI9341_HandleTypeDef* ili9341,
-    uint16_t x,
-    uint16_t y,
-    char ch,
+static inline uint32_t ILI9341_GlyphBits(const uint32_t* glyph, uint32_t bit_index, uint8_t count) {
+    const uint32_t* word = &glyph[bit_index / 32];
+    uint32_t shift = bit_index % 32;
+    uint32_t bits = word[0] << shift;
+    if (shift + count > 32) bits |= word[1] >> (32 - shift);
+    return bits;
+}
+
+/**
+ * @brief Set the colors of the glyph expander, its table is rebuilt only if they changed
+ * @param expander Pointer to the glyph expander
+ * @param color 16-bit color of the set bits in RGB565 format
+ * @param bgcolor 16-bit color of the clear bits in RGB565 format
+ */
+static void ILI9341_GlyphExpanderSetColors(ILI9341_GlyphExpanderTypeDef* expander, uint16_t color, uint16_t bgcolor) {
+    if (expander->valid && expander->color == color && expander->bgcolor == bgcolor) return;
+
+    expander->color = color;
+    expander->bgcolor = bgcolor;
+    expander->valid = true;
+    #if !defined(ILI9341_GLYPH_SIMD_WORD) && !defined(ILI9341_GLYPH_SIMD_VECTOR)
+    for (uint8_t bits = 0; bits < 16; bits++) {
+        for (uint8_t i = 0; i < 4; i++) { expander->pixels[bits][i] = (bits & (0x08 >> i)) ? color : bgcolor; }
+    }
+    #endif
+}
+
+/**
+ * @brief Expand 8 glyph bits into 8 pixels
+ * @param expander Pointer to the glyph expander
+ * @param bits Glyph bits, the first pixel in the most significant bit
+ * @param pixels Pointer to the 8 pixels to write
+ */
+static inline void ILI9341_ExpandGlyphBits(
+    const ILI9341_GlyphExpanderTypeDef* expander,
+    uint8_t bits,
+    uint16_t* pixels
+) {
+    #if defined(ILI9341_GLYPH_SIMD_WORD)
+    // a pair of bits gives the halfwords of the word taking the color, the first pixel in the lower halfword
+    static const uint32_t masks[4] = {0x00000000, 0xFFFF0000, 0x0000FFFF, 0xFFFFFFFF};
+    uint32_t color = expander->color * 0x00010001U;
+    uint32_t bgcolor = expander->bgcolor * 0x00010001U;
+    for (int8_t shift = 6; shift >= 0; shift -= 2, pixels += 2) {
+        uint32_t mask = masks[(bits >> shift) & 0x03];
+        uint32_t pair = (color & mask) | (bgcolor & ~mask);
+        memcpy(pixels, &pair, sizeof(pair));
+    }
+    #elif defined(ILI9341_GLYPH_SIMD_VECTOR)
+    static const ILI9341_Pixels8 lanes = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
+    ILI9341_Pixels8 set = (ILI9341_Pixels8)((lanes & bits) != 0);
+    ILI9341_Pixels8 result = (set & expander->color) | (~set & expander->bgcolor);
+    memcpy(pixels, &result, sizeof(result));
+    #else
+    memcpy(pixels, expander->pixels[bits >> 4], sizeof(expander->pixels[0]));
+    memcpy(pixels + 4, expander->pixels[bits & 0x0F], sizeof(expander->pixels[0]));
+    #endif
+}
+
+/**
+ * @brief Expand consecutive bits of a glyph into pixels
+ * @param expander Pointer to the glyph expander
+ * @param glyph Pointer to the glyph bits
+ * @param bit_index Index of the first bit
+ * @param count Number of bits
+ * @param pixels Pointer to the count pixels to write
+ */
+static void ILI9341_ExpandGlyphRow(
+    const ILI9341_GlyphExpanderTypeDef* expander,
+    const uint32_t* glyph,
+    uint32_t bit_index,
+    uint16_t count,
+    uint16_t* pixels
+) {
+    while (count > 0) {
+        uint8_t chunk = count < 32 ? count : 32;
+        uint32_t bits = ILI9341_GlyphBits(glyph, bit_index, chunk);
+        bit_index += chunk;
+        count -= chunk;
+
+        for (; chunk >= 8; chunk -= 8, bits <<= 8, pixels += 8) {
+            ILI9341_ExpandGlyphBits(expander, bits >> 24, pixels);
+        }
+        if (chunk > 0) {
+            uint16_t tail[8];
+            ILI9341_ExpandGlyphBits(expander, bits >> 24, tail);
+            memcpy(pixels, tail, chunk * sizeof(uint16_t));
+            pixels += chunk;
+        }
+    }
+}
+
+/**
+ * @brief Find the expanded pixels of a glyph in the cache, expanding it into the least recently used entry if missing
+ * @param cache Pointer to the glyph cache
+ * @param expander Pointer to the glyph expander, set to the colors of the glyph
+ * @param font Font definition of the glyph
+ * @param ch ASCII character, from 32 to 126
+ * @param scale Scaling factor (integer) of the glyph
+ * @return Pointer to the font.width * scale by font.height * scale pixels of the glyph, NULL if it is not in the cache
+ * and every entry holds a glyph of the line being drawn
+ */
+static const uint16_t* ILI9341_GlyphCacheGet(
+    ILI9341_GlyphCacheTypeDef* cache,
+    const ILI9341_GlyphExpanderTypeDef* expander,
     ILI9341_FontDef font,
-    uint16_t color,
-    uint16_t bgcolor
+    char ch,
+    uint16_t scale
 ) {
-    if (ch < 32 || ch > 126) ch = 32;
+    // free entries are taken first, then the least recently used one, never one of the line being drawn
+    ILI9341_GlyphCacheEntryTypeDef* victim = NULL;
+    for (uint16_t i = 0; i < cache->capacity; i++) {
+        ILI9341_GlyphCacheEntryTypeDef* entry = &cache->entries[i];
+        if (entry->font_data == font.data && entry->ch == ch && entry->color == expander->color &&
+            entry->bgcolor == expander->bgcolor && entry->scale == scale) {
+            entry->last_used = cache->tick;
+            cache->hits++;
+            return &cache->pixels[(uint32_t)i * cache->glyph_pixels];
+        }
+        if (entry->font_data && entry->last_used == cache->tick) continue;
+        if (!victim || (victim->font_data && (!entry->font_data ||
+                                              cache->tick - entry->last_used > cache->tick - victim->last_used))) {
+            victim = entry;
+        }
+    }
 
-    uint16_t index = (ch - 32) * font.intsPerGlyph;
-    uint32_t mask = 0x80000000;
+    cache->misses++;
+    if (!victim) return NULL;
 
-    uint8_t bg_data[] = {bgcolor >> 8, bgcolor & 0xFF};
-    uint8_t fg_data[] = {color >> 8, color & 0xFF};
+    *victim = (ILI9341_GlyphCacheEntryTypeDef){
+        .font_data = font.data,
+        .color = expander->color,
+        .bgcolor = expander->bgcolor,
+        .scale = scale,
+        .ch = ch,
+        .last_used = cache->tick
+    };
+    uint16_t* pixels = &cache->pixels[(uint32_t)(victim - cache->entries) * cache->glyph_pixels];
 
-    ILI9341_SetAddressWindow(ili9341, x, y, x + font.width - 1, y + font.height - 1);
+    // every row of the glyph is expanded once, repeated scale times along the row and copied to the next scale - 1 rows
+    const uint32_t* glyph = &font.data[(ch - 32) * font.intsPerGlyph];
+    uint32_t cell_width = (uint32_t)font.width * scale;
+    for (uint16_t row = 0; row < font.height; row++) {
+        uint16_t* out = &pixels[(uint32_t)row * scale * cell_width];
+        if (scale == 1) {
+            ILI9341_ExpandGlyphRow(expander, glyph, (uint32_t)row * font.width, font.width, out);
+            continue;
+        }
 
-    for (uint16_t i = 0; i < font.width * font.height; i++) {
-        if (font.data[index] & mask) {
-            ILI9341_WriteData(ili9341, fg_data, sizeof(fg_data));
-        } else {
-            ILI9341_WriteData(ili9341, bg_data, sizeof(bg_data));
+        uint16_t* next = out;
+        for (uint16_t col = 0; col < font.width; col += 32) {
+            uint16_t expanded[32];
+            uint16_t expanded_count = font.width - col < 32 ? font.width - col : 32;
+            ILI9341_ExpandGlyphRow(expander, glyph, (uint32_t)row * font.width + col, expanded_count, expanded);
+            for (uint16_t k = 0; k < expanded_count; k++) {
+                for (uint16_t repeat = 0; repeat < scale; repeat++) { *next++ = expanded[k]; }
+            }
         }
-        mask >>= 1;
-        if (mask == 0) {
-            index++;
-            mask = 0x80000000;
+        for (uint16_t repeat = 1; repeat < scale; repeat++) {
+            memcpy(out + repeat * cell_width, out, cell_width * sizeof(uint16_t));
         }
     }
+
+    return pixels;
 }
 
-void ILI9341_WriteString(
+void ILI9341_AttachGlyphCache(
     ILI9341_HandleTypeDef* ili9341,
-    uint16_t x,
-    uint16_t y,
-    const char* str,
-    ILI9341_FontDef font,
-    uint16_t color,
-    uint16_t bgcolor,
-    int16_t tracking
+    ILI9341_GlyphCacheTypeDef* cache,
+    void* arena,
+    size_t size,
+    uint32_t glyph_pixels
 ) {
-    if (y + font.height - 1 > ili9341->height) return;
-
-    ILI9341_Select(ili9341);
-
-    while (*str && x + font.width - 1 < ili9341->width) {
-        ILI9341_WriteChar(ili9341, x, y, *str, font, color, bgcolor);
-        x += font.width + tracking;
-        str++;
+    if (cache) {
+        // entries first, aligned for their pointer, then the pixels of each of them
+        uint8_t* aligned = (uint8_t*)(((uintptr_t)arena + 7) & ~(uintptr_t)7);
+        size_t skipped = aligned - (uint8_t*)arena;
+        size_t entry_size = sizeof(ILI9341_GlyphCacheEntryTypeDef) + (size_t)glyph_pixels * sizeof(uint16_t);
+        size_t capacity = size > skipped ? (size - skipped) / entry_size : 0;
+        if (capacity > UINT16_MAX) capacity = UINT16_MAX;
+
+        *cache = (ILI9341_GlyphCacheTypeDef){
+            .entries = (ILI9341_GlyphCacheEntryTypeDef*)aligned,
+            .pixels = (uint16_t*)(aligned + capacity * sizeof(ILI9341_GlyphCacheEntryTypeDef)),
+            .capacity = capacity,
+            .glyph_pixels = glyph_pixels
+        };
+        for (uint16_t i = 0; i < cache->capacity; i++) { cache->entries[i].font_data = NULL; }
     }
 
-    ILI9341_Deselect(ili9341);
+    ili9341->glyph_cache = cache;
 }
 
 /**
- * @brief Write a scaled character at specified coordinates without selecting/deselecting the display
+ * @brief Write the part of a line of text inside the clip rectangle without selecting/deselecting the display
  * @param ili9341 Pointer to ILI9341 handle structure
- * @param x X coordinate of the top-left of the character
- * @param y Y coordinate of the top-left of the character
- * @param ch ASCII character to write
- * @param font Font definition to use for rendering the character
+ * @param x X coordinate of the top-left of the first character
+ * @param y Y coordinate of the top-left of the line
+ * @param str Null-terminated string to write
+ * @param font Font definition to use for rendering the characters
  * @param color 16-bit character color in RGB565 format
  * @param bgcolor 16-bit background color in RGB565 format
- * @param scale Scaling factor (integer) to enlarge the character
+ * @param scale Scaling factor (integer) to enlarge the characters
+ * @param tracking Additional space in pixels between characters, can be negative
+ * @note The line is sent row by row across its full width in a single address window, the gaps between characters
+ * are filled with the background color. Where characters overlap a pixel has the character color if any of them has
+ * it set, whatever their order.
  */
-static void ILI9341_WriteCharScaled(
+static void ILI9341_WriteLine(
     ILI9341_HandleTypeDef* ili9341,
-    uint16_t x,
-    uint16_t y,
-    char ch,
+    int32_t x,
+    int32_t y,
+    const char* str,
     ILI9341_FontDef font,
     uint16_t color,
     uint16_t bgcolor,
-    uint16_t scale
+    uint16_t scale,
+    int16_t tracking
 ) {
-    if (ch < 32 || ch > 126) ch = 32;
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    int32_t cell_width = (int32_t)font.width * scale;
+    int32_t advance = cell_width + tracking;
+
+    // characters past the clip rectangle in the direction the cursor moves are left out, the gap before the first of
+    // them still reaches the edge of the clip rectangle
+    int32_t count = 0;
+    int32_t left = x;
+    int32_t right = x + cell_width - 1;
+    for (int32_t cursor = x; str[count]; count++, cursor += advance) {
+        if (advance > 0 && cursor > clip.x1) {
+            if (count > 0) right = clip.x1;
+            break;
+        }
+        if (advance <= 0 && cursor + cell_width - 1 < clip.x0) {
+            if (count > 0) left = clip.x0;
+            break;
+        }
+        if (cursor < left) left = cursor;
+        if (cursor + cell_width - 1 > right) right = cursor + cell_width - 1;
+    }
+
+    ILI9341_RectTypeDef visible;
+    if (count == 0 || !ILI9341_ClipBox(ili9341, left, y, right - left + 1, font.height * scale, &visible)) return;
+
+    ILI9341_GlyphExpanderTypeDef* expander = &ili9341->glyph_expander;
+    ILI9341_GlyphExpanderSetColors(expander, color, bgcolor);
+
+    // without gaps the characters cover every column of the line
+    bool gaps = tracking > 0 || advance < 0;
+
+    // the visible characters of the line are looked up once, they are copied from the cache row after row
+    const uint16_t* cached[ILI9341_GLYPH_CACHE_LINE];
+    int32_t cached_count = 0;
+    ILI9341_GlyphCacheTypeDef* cache = ili9341->glyph_cache;
+    if (cache && (uint32_t)cell_width * font.height * scale <= cache->glyph_pixels) {
+        cache->tick++;
+        cached_count = count < ILI9341_GLYPH_CACHE_LINE ? count : ILI9341_GLYPH_CACHE_LINE;
+        for (int32_t i = 0; i < cached_count; i++) {
+            int32_t cell = x - left + i * advance;
+            char ch = (str[i] < 32 || str[i] > 126) ? 32 : str[i];
+            bool shown = cell <= visible.x1 && cell + cell_width > visible.x0;
+            cached[i] = shown ? ILI9341_GlyphCacheGet(cache, expander, font, ch, scale) : NULL;
+        }
+    }
 
-    uint8_t bg_data[] = {bgcolor >> 8, bgcolor & 0xFF};
-    uint8_t fg_data[] = {color >> 8, color & 0xFF};
+    uint16_t buffer[ILI9341_TEXT_BUFFER_SIZE];
+    ILI9341_PixelWriterTypeDef writer;
+    ILI9341_PixelWriterBegin(&writer, ili9341, buffer, ILI9341_TEXT_BUFFER_SIZE);
 
-    ILI9341_SetAddressWindow(ili9341, x, y, x + font.width * scale - 1, y + font.height * scale - 1);
+    ILI9341_SetAddressWindow(ili9341, left + visible.x0, y + visible.y0, left + visible.x1, y + visible.y1);
 
-    uint32_t bit_index = (ch - 32) * font.intsPerGlyph * 32;
-    for (uint16_t row = 0; row < font.height; row++) {
-        for (uint16_t v_scale = 0; v_scale < scale; v_scale++) {
-            for (uint16_t col = 0; col < font.width; col++) {
-                uint32_t mask = 0x80000000 >> (bit_index % 32);
-                uint16_t index = bit_index / 32;
-                for (uint16_t h_scale = 0; h_scale < scale; h_scale++) {
-                    if (font.data[index] & mask) {
-                        ILI9341_WriteData(ili9341, fg_data, sizeof(fg_data));
-                    } else {
-                        ILI9341_WriteData(ili9341, bg_data, sizeof(bg_data));
+    for (uint16_t row = visible.y0; row <= visible.y1; row++) {
+        uint32_t glyph_row = (uint32_t)(row / scale) * font.width;
+
+        // columns are relative to the left of the line, a row is split where the writer's buffer fills up
+        for (int32_t col = visible.x0; col <= visible.x1;) {
+            uint16_t size = visible.x1 - col + 1;
+            uint16_t* pixels = ILI9341_PixelWriterReserve(&writer, &size);
+            if (gaps) {
+                for (uint16_t i = 0; i < size; i++) { pixels[i] = bgcolor; }
+            }
+
+            for (int32_t i = 0; i < count; i++) {
+                int32_t cell = x - left + i * advance;
+                if (advance > 0 && cell > col + size - 1) break;
+                int32_t first = cell > col ? cell : col;
+                int32_t last = cell + cell_width < col + size ? cell + cell_width - 1 : col + size - 1;
+                if (first > last) continue;
+
+                // columns shared with the previous character only take the set pixels of this one
+                int32_t shared0 = cell;
+                int32_t shared1 = cell - 1;
+                if (i > 0) {
+                    int32_t previous = cell - advance;
+                    shared0 = cell > previous ? cell : previous;
+                    shared1 = (cell < previous ? cell : previous) + cell_width - 1;
+                }
+
+                if (i < cached_count && cached[i]) {
+                    const uint16_t* source = &cached[i][(uint32_t)row * cell_width + (first - cell)];
+                    if (first > shared1 || last < shared0) {
+                        memcpy(&pixels[first - col], source, (last - first + 1) * sizeof(uint16_t));
+                        continue;
+                    }
+                    for (int32_t c = first; c <= last; c++, source++) {
+                        if (c < shared0 || c > shared1 || *source == color) pixels[c - col] = *source;
+                    }
+                    continue;
+                }
+
+                char ch = (str[i] < 32 || str[i] > 126) ? 32 : str[i];
+                const uint32_t* glyph = &font.data[(ch - 32) * font.intsPerGlyph];
+                if (scale == 1 && (first > shared1 || last < shared0)) {
+                    uint16_t* out = &pixels[first - col];
+                    ILI9341_ExpandGlyphRow(expander, glyph, glyph_row + first - cell, last - first + 1, out);
+                    continue;
+                }
+
+                // expanded up to 32 glyph columns at a time, each one repeated scale times
+                for (int32_t c = first; c <= last;) {
+                    uint32_t glyph_col = (c - cell) / scale;
+                    uint16_t repeat = (c - cell) % scale;
+                    uint16_t expanded_count = (last - cell) / scale - glyph_col + 1;
+                    if (expanded_count > 32) expanded_count = 32;
+
+                    uint16_t expanded[32];
+                    ILI9341_ExpandGlyphRow(expander, glyph, glyph_row + glyph_col, expanded_count, expanded);
+                    for (uint16_t k = 0; k < expanded_count; k++, repeat = 0) {
+                        for (; repeat < scale && c <= last; repeat++, c++) {
+                            if (c < shared0 || c > shared1 || expanded[k] == color) pixels[c - col] = expanded[k];
+                        }
                     }
                 }
-                bit_index++;
             }
-            bit_index -= font.width;
+
+            col += size;
         }
-        bit_index += font.width;
     }
+
+    ILI9341_PixelWriterFlush(&writer);
+}
+
+void ILI9341_WriteString(
+    ILI9341_HandleTypeDef* ili9341,
+    uint16_t x,
+    uint16_t y,
+    const char* str,
+    ILI9341_FontDef font,
+    uint16_t color,
+    uint16_t bgcolor,
+    int16_t tracking
+) {
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    if (!ILI9341_ClipBox(ili9341, clip.x0, y, clip.x1 - clip.x0 + 1, font.height, NULL)) return;
+
+    ILI9341_Select(ili9341);
+    ILI9341_WriteLine(ili9341, x, y, str, font, color, bgcolor, 1, tracking);
+    ILI9341_Deselect(ili9341);
 }
 
 void ILI9341_WriteStringScaled(
@@ -579,50 +1857,78 @@ void ILI9341_WriteStringScaled(
     uint16_t scale,
     int16_t tracking
 ) {
-    if (y + font.height * scale - 1 > ili9341->height) return;
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    if (!ILI9341_ClipBox(ili9341, clip.x0, y, clip.x1 - clip.x0 + 1, font.height * scale, NULL)) return;
 
     ILI9341_Select(ili9341);
+    ILI9341_WriteLine(ili9341, x, y, str, font, color, bgcolor, scale, tracking);
+    ILI9341_Deselect(ili9341);
+}
 
-    while (*str && x + font.width * scale - 1 < ili9341->width) {
-        ILI9341_WriteCharScaled(ili9341, x, y, *str, font, color, bgcolor, scale);
-        x += font.width * scale + tracking;
-        str++;
-    }
+/**
+ * @brief Skip the columns of a glyph row holding the given bit value
+ * @param glyph Pointer to the glyph bits
+ * @param row_index Index of the first bit of the row
+ * @param col First column to look at
+ * @param last Last column to look at
+ * @param set Value of the bits to skip
+ * @return First column from col holding the other value, last + 1 if there is none
+ * @note The bits are taken up to 32 at a time, a word of skipped bits is a single test.
+ */
+static uint16_t ILI9341_GlyphSkip(const uint32_t* glyph, uint32_t row_index, uint16_t col, uint16_t last, bool set) {
+    while (col <= last) {
+        uint8_t count = last - col + 1 < 32 ? last - col + 1 : 32;
+        uint32_t bits = ILI9341_GlyphBits(glyph, row_index + col, count);
+        if (set) bits = ~bits;
+        bits &= 0xFFFFFFFF << (32 - count);
+        if (bits == 0) {
+            col += count;
+            continue;
+        }
 
-    ILI9341_Deselect(ili9341);
+        for (; !(bits & 0x80000000); bits <<= 1) { col++; }
+        return col;
+    }
+    return col;
 }
 
 /**
- * @brief Write a character with transparent background at specified coordinates without selecting/deselecting the
- * display
+ * @brief Write the part of a scaled character inside the clip rectangle with transparent background without
+ * selecting/deselecting the display
  * @param ili9341 Pointer to ILI9341 handle structure
  * @param x X coordinate of the top-left of the character
  * @param y Y coordinate of the top-left of the character
  * @param ch ASCII character to write
  * @param font Font definition to use for rendering the character
  * @param color 16-bit character color in RGB565 format
+ * @param scale Scaling factor (integer) to enlarge the character
+ * @note Each run of set bits in a row of the glyph is filled as one span, scale rows high.
  */
 static void ILI9341_WriteCharTransparent(
     ILI9341_HandleTypeDef* ili9341,
-    uint16_t x,
-    uint16_t y,
+    int32_t x,
+    int32_t y,
     char ch,
     ILI9341_FontDef font,
-    uint16_t color
+    uint16_t color,
+    uint16_t scale
 ) {
-    if (ch < 32 || ch > 126) ch = 32;
-
-    uint16_t index = (ch - 32) * font.intsPerGlyph;
-    uint32_t mask = 0x80000000;
+    ILI9341_RectTypeDef visible;
+    if (!ILI9341_ClipBox(ili9341, x, y, font.width * scale, font.height * scale, &visible)) return;
 
-    for (uint16_t row = 0; row < font.height; row++) {
-        for (uint16_t col = 0; col < font.width; col++) {
-            if (font.data[index] & mask) { ILI9341_DrawPixelFast(ili9341, x + col, y + row, color); }
-            mask >>= 1;
-            if (mask == 0) {
-                index++;
-                mask = 0x80000000;
-            }
+    if (ch < 32 || ch > 126) ch = 32;
+    const uint32_t* glyph = &font.data[(ch - 32) * font.intsPerGlyph];
+
+    // only the glyph bits with a visible square are looked at, the runs are clipped as spans
+    uint16_t last = visible.x1 / scale;
+    for (uint16_t row = visible.y0 / scale; row <= visible.y1 / scale; row++) {
+        uint32_t row_index = (uint32_t)row * font.width;
+        int32_t y0 = y + row * scale;
+        uint16_t col = ILI9341_GlyphSkip(glyph, row_index, visible.x0 / scale, last, false);
+        while (col <= last) {
+            uint16_t end = ILI9341_GlyphSkip(glyph, row_index, col, last, true);
+            ILI9341_FillSpanFast(ili9341, x + col * scale, y0, x + end * scale - 1, y0 + scale - 1, color);
+            col = ILI9341_GlyphSkip(glyph, row_index, end, last, false);
         }
     }
 }
@@ -636,58 +1942,19 @@ void ILI9341_WriteStringTransparent(
     uint16_t color,
     int16_t tracking
 ) {
-    if (y + font.height - 1 > ili9341->height) return;
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    if (!ILI9341_ClipBox(ili9341, clip.x0, y, clip.x1 - clip.x0 + 1, font.height, NULL)) return;
 
     ILI9341_Select(ili9341);
 
-    while (*str && x + font.width - 1 < ili9341->width) {
-        ILI9341_WriteCharTransparent(ili9341, x, y, *str, font, color);
-        x += font.width + tracking;
-        str++;
+    for (int32_t cursor = x; *str && cursor <= clip.x1; str++) {
+        ILI9341_WriteCharTransparent(ili9341, cursor, y, *str, font, color, 1);
+        cursor += font.width + tracking;
     }
 
     ILI9341_Deselect(ili9341);
 }
 
-/**
- * @brief Write a scaled character with transparent background at specified coordinates without selecting/deselecting
- * the display
- * @param ili9341 Pointer to ILI9341 handle structure
- * @param x X coordinate of the top-left of the character
- * @param y Y coordinate of the top-left of the character
- * @param ch ASCII character to write
- * @param font Font definition to use for rendering the character
- * @param color 16-bit character color in RGB565 format
- * @param scale Scaling factor (integer) to enlarge the character
- */
-static void ILI9341_WriteCharTransparentScaled(
-    ILI9341_HandleTypeDef* ili9341,
-    uint16_t x,
-    uint16_t y,
-    char ch,
-    ILI9341_FontDef font,
-    uint16_t color,
-    uint16_t scale
-) {
-    if (ch < 32 || ch > 126) ch = 32;
-
-    uint16_t index = (ch - 32) * font.intsPerGlyph;
-    uint32_t mask = 0x80000000;
-
-    for (uint16_t row = 0; row < font.height; row++) {
-        for (uint16_t col = 0; col < font.width; col++) {
-            if (font.data[index] & mask) {
-                ILI9341_FillRectangleFast(ili9341, x + col * scale, y + row * scale, scale, scale, color);
-            }
-            mask >>= 1;
-            if (mask == 0) {
-                index++;
-                mask = 0x80000000;
-            }
-        }
-    }
-}
-
 void ILI9341_WriteStringTransparentScaled(
     ILI9341_HandleTypeDef* ili9341,
     uint16_t x,
@@ -698,36 +1965,69 @@ void ILI9341_WriteStringTransparentScaled(
     uint16_t scale,
     int16_t tracking
 ) {
-    if (y + font.height * scale - 1 > ili9341->height) return;
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    if (!ILI9341_ClipBox(ili9341, clip.x0, y, clip.x1 - clip.x0 + 1, font.height * scale, NULL)) return;
 
     ILI9341_Select(ili9341);
 
-    while (*str && x + font.width * scale - 1 < ili9341->width) {
-        ILI9341_WriteCharTransparentScaled(ili9341, x, y, *str, font, color, scale);
-        x += font.width * scale + tracking;
-        str++;
+    for (int32_t cursor = x; *str && cursor <= clip.x1; str++) {
+        ILI9341_WriteCharTransparent(ili9341, cursor, y, *str, font, color, scale);
+        cursor += font.width * scale + tracking;
     }
 
     ILI9341_Deselect(ili9341);
 }
 
-void ILI9341_DrawImage(
+/**
+ * @brief Draw the part of an image inside the clip rectangle
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x X coordinate of the top-left corner of the image
+ * @param y Y coordinate of the top-left corner of the image
+ * @param w Width of the image in pixels
+ * @param h Height of the image in pixels
+ * @param data Pointer to the image pixel data in RGB565 format
+ * @note The visible part is a single address window, its rows are sent one after the other, or all together when
+ * they are whole rows of the image.
+ */
+static void ILI9341_DrawImageClipped(
     ILI9341_HandleTypeDef* ili9341,
-    uint16_t x,
-    uint16_t y,
+    int32_t x,
+    int32_t y,
     uint16_t w,
     uint16_t h,
     const uint16_t* data
 ) {
-    if (x >= ili9341->width || y >= ili9341->height || (x + w - 1) >= ili9341->width || (y + h - 1) >= ili9341->height)
-        return;
+    ILI9341_RectTypeDef visible;
+    if (w == 0 || h == 0 || !ILI9341_ClipBox(ili9341, x, y, w, h, &visible)) return;
+
+    uint32_t columns = visible.x1 - visible.x0 + 1;
+    uint32_t rows = visible.y1 - visible.y0 + 1;
+    const uint16_t* row = &data[(uint32_t)visible.y0 * w + visible.x0];
+
+    ILI9341_PixelWriterTypeDef writer;
+    ILI9341_PixelWriterBegin(&writer, ili9341, NULL, 0);
 
     ILI9341_Select(ili9341);
-    ILI9341_SetAddressWindow(ili9341, x, y, x + w - 1, y + h - 1);
-    ILI9341_WriteData(ili9341, (uint8_t*)data, sizeof(uint16_t) * w * h);
+    ILI9341_SetAddressWindow(ili9341, x + visible.x0, y + visible.y0, x + visible.x1, y + visible.y1);
+    if (columns == w) {
+        ILI9341_PixelWriterCopy(&writer, row, columns * rows);
+    } else {
+        for (uint32_t i = 0; i < rows; i++, row += w) { ILI9341_PixelWriterCopy(&writer, row, columns); }
+    }
+    ILI9341_PixelWriterFlush(&writer);
     ILI9341_Deselect(ili9341);
 }
 
+void ILI9341_DrawImage(
+    ILI9341_HandleTypeDef* ili9341,
+    uint16_t x,
+    uint16_t y,
+    uint16_t w,
+    uint16_t h,
+    const uint16_t* data
+) {
+    ILI9341_DrawImageClipped(ili9341, x, y, w, h, data);
+}
 
 void ILI9341_DrawImageWithClip(
     ILI9341_HandleTypeDef* ili9341,
@@ -737,39 +2037,149 @@ void ILI9341_DrawImageWithClip(
     uint16_t h,
     const uint16_t* data
 ) {
-    int16_t dataRow = 0;
-    if (y < 0) dataRow = -y;
+    ILI9341_DrawImageClipped(ili9341, x, y, w, h, data);
+}
+
+/**
+ * @brief Convert pixels received from the display memory to RGB565
+ * @param rgb Pointer to the received bytes, red, green and blue of each pixel with the 6 bits left aligned
+ * @param pixels Buffer receiving the pixels in RGB565 format
+ * @param count Number of pixels
+ */
+static void ILI9341_ConvertRGB666(const uint8_t* rgb, uint16_t* pixels, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, rgb += 3) { pixels[i] = ILI9341_COLOR565(rgb[0], rgb[1], rgb[2]); }
+}
 
-    uint16_t readDataFromIndex = 0;
-    int16_t columnStart = x;
-    if (x < 0) {
-        readDataFromIndex -= x;
-        columnStart = 0;
+/**
+ * @brief Read pixels from the display memory without selecting/deselecting the display
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param cmd 0x2E (RAMRD) to start at the top-left corner of the address window, 0x3E (RAMRDC) to continue after the
+ * last pixel read
+ * @param pixels Buffer receiving the pixels in RGB565 format
+ * @param count Number of pixels
+ * @note The panel answers a read command with a dummy byte, then 3 bytes per pixel. They are received
+ * ILI9341_READ_CHUNK_PIXELS at a time, the dummy byte with the first chunk, and each chunk is converted as a whole.
+ */
+static void ILI9341_ReadPixels(ILI9341_HandleTypeDef* ili9341, uint8_t cmd, uint16_t* pixels, uint32_t count) {
+    uint8_t buffer[1 + ILI9341_READ_CHUNK_PIXELS * 3];
+    uint8_t skip = 1;
+
+    ILI9341_WriteCommand(ili9341, cmd);
+    while (count > 0) {
+        uint32_t chunk_size = count < ILI9341_READ_CHUNK_PIXELS ? count : ILI9341_READ_CHUNK_PIXELS;
+        ILI9341_ReadData(ili9341, buffer, skip + chunk_size * 3);
+        ILI9341_ConvertRGB666(buffer + skip, pixels, chunk_size);
+        skip = 0;
+        pixels += chunk_size;
+        count -= chunk_size;
     }
+}
 
-    uint16_t readDataToIndex = w;
-    int16_t columnEnd = x + w - 1;
-    if (columnEnd >= ili9341->width) {
-        readDataToIndex -= (w + x) - ili9341->width;
-        columnEnd = ili9341->width - 1;
+/**
+ * @brief Set the address window for subsequent memory reads
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x0 X coordinate of the top-left corner of the window
+ * @param y0 Y coordinate of the top-left corner of the window
+ * @param x1 X coordinate of the bottom-right corner of the window
+ * @param y1 Y coordinate of the bottom-right corner of the window
+ * @note The window is always sent and becomes the cached one, the following writes can reuse it.
+ */
+static void ILI9341_SetReadWindow(ILI9341_HandleTypeDef* ili9341, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+    ILI9341_WriteCommand(ili9341, 0x2A);  // CASET
+    {
+        uint8_t data[] = {(x0 >> 8) & 0xFF, x0 & 0xFF, (x1 >> 8) & 0xFF, x1 & 0xFF};
+        ILI9341_WriteData(ili9341, data, sizeof(data));
+    }
+    ILI9341_WriteCommand(ili9341, 0x2B);  // RASET
+    {
+        uint8_t data[] = {(y0 >> 8) & 0xFF, y0 & 0xFF, (y1 >> 8) & 0xFF, y1 & 0xFF};
+        ILI9341_WriteData(ili9341, data, sizeof(data));
     }
 
-    uint16_t bufferSize = readDataToIndex - readDataFromIndex;
-    if (bufferSize == 0 || h == 0) return;
-    uint16_t buffer[bufferSize];
+    ili9341->window_x0 = x0;
+    ili9341->window_y0 = y0;
+    ili9341->window_x1 = x1;
+    ili9341->window_y1 = y1;
+    ili9341->window_valid = true;
+}
 
-    ILI9341_Select(ili9341);
-    for (; dataRow < h; dataRow += 1) {
-        int16_t displayRow = y + dataRow;
-        if (displayRow < 0) continue;
-        if (displayRow >= ili9341->height) break;
-        memcpy(buffer, &data[dataRow * w + readDataFromIndex], sizeof(uint16_t) * bufferSize);
-        ILI9341_SetAddressWindow(ili9341, columnStart, displayRow, columnEnd, displayRow);
-        ILI9341_WriteData(ili9341, (uint8_t*)buffer, sizeof(uint16_t) * bufferSize);
+bool ILI9341_ReadRect(
+    ILI9341_HandleTypeDef* ili9341,
+    uint16_t x,
+    uint16_t y,
+    uint16_t w,
+    uint16_t h,
+    uint16_t* pixels
+) {
+    if (w == 0 || h == 0 || x >= ili9341->width || y >= ili9341->height) return false;
+    if (w > ili9341->width - x || h > ili9341->height - y) return false;
+    if (ili9341->display_list) return false;
+
+    ILI9341_FramebufferTypeDef* framebuffer = ili9341->framebuffer;
+    if (framebuffer) {
+        // the framebuffer holds what the panel shows once flushed
+        const uint16_t* row = &framebuffer->pixels[(uint32_t)y * framebuffer->width + x];
+        for (uint16_t i = 0; i < h; i++, row += framebuffer->width, pixels += w) {
+            memcpy(pixels, row, w * sizeof(uint16_t));
+        }
+        return true;
     }
+
+    ILI9341_Select(ili9341);
+    ILI9341_SetReadWindow(ili9341, x, y, x + w - 1, y + h - 1);
+    ILI9341_ReadPixels(ili9341, 0x2E /* RAMRD */, pixels, (uint32_t)w * h);
     ILI9341_Deselect(ili9341);
+    return true;
 }
 
+bool ILI9341_Screenshot(
+    ILI9341_HandleTypeDef* ili9341,
+    uint16_t* buffer,
+    uint32_t buffer_size,
+    ILI9341_ScreenshotWriteFunc write,
+    void* arg
+) {
+    if (ili9341->display_list) return false;
+
+    uint16_t width = ili9341->width;
+    uint16_t height = ili9341->height;
+    ILI9341_FramebufferTypeDef* framebuffer = ili9341->framebuffer;
+    uint32_t buffer_rows = buffer_size / width;
+    uint16_t chunk_rows = framebuffer || buffer_rows > height ? height : buffer_rows;
+    if (chunk_rows == 0) return false;
+
+    uint8_t header[ILI9341_SCREENSHOT_HEADER_SIZE] = {0};
+    memcpy(header, ILI9341_SCREENSHOT_MAGIC, 4);
+    header[4] = ILI9341_SCREENSHOT_VERSION & 0xFF;
+    header[5] = ILI9341_SCREENSHOT_VERSION >> 8;
+    header[6] = width & 0xFF;
+    header[7] = width >> 8;
+    header[8] = height & 0xFF;
+    header[9] = height >> 8;
+    if (!write(header, sizeof(header), arg)) return false;
+
+    for (uint16_t y = 0; y < height;) {
+        uint16_t rows = height - y < chunk_rows ? (uint16_t)(height - y) : chunk_rows;
+        const uint16_t* pixels = buffer;
+
+        if (framebuffer) {
+            pixels = &framebuffer->pixels[(uint32_t)y * width];
+        } else {
+            // the chip select is released while the chunk is written out, the read goes on with RAMRDC
+            ILI9341_Select(ili9341);
+            if (y == 0) ILI9341_SetReadWindow(ili9341, 0, 0, width - 1, height - 1);
+            ILI9341_ReadPixels(ili9341, y == 0 ? 0x2E /* RAMRD */ : 0x3E /* RAMRDC */, buffer, (uint32_t)rows * width);
+            ILI9341_Deselect(ili9341);
+        }
+
+        uint8_t chunk[ILI9341_SCREENSHOT_CHUNK_HEADER_SIZE] = {y & 0xFF, y >> 8, rows & 0xFF, rows >> 8};
+        if (!write(chunk, sizeof(chunk), arg)) return false;
+        if (!write(pixels, (size_t)rows * width * sizeof(uint16_t), arg)) return false;
+        y += rows;
+    }
+
+    return true;
+}
 
 void ILI9341_InvertColors(ILI9341_HandleTypeDef* ili9341, bool invert) {
     ILI9341_Select(ili9341);
@@ -778,13 +2188,33 @@ void ILI9341_InvertColors(ILI9341_HandleTypeDef* ili9341, bool invert) {
 }
 
 /**
- * @brief Draw a line using Bresenham's algorithm without selecting/deselecting the display
+ * @brief Narrow a range of steps along an axis to the steps whose coordinate is inside the clip rectangle
+ * @param start Coordinate of step 0
+ * @param step Coordinate increment per step, 1 or -1
+ * @param low First coordinate of the clip rectangle along the axis
+ * @param high Last coordinate of the clip rectangle along the axis
+ * @param first Pointer to the first step of the range, updated
+ * @param last Pointer to the last step of the range, updated
+ */
+static void ILI9341_ClipSteps(int32_t start, int32_t step, int32_t low, int32_t high, int32_t* first, int32_t* last) {
+    int32_t first_step = step > 0 ? low - start : start - high;
+    int32_t last_step = step > 0 ? high - start : start - low;
+    if (*first < first_step) *first = first_step;
+    if (*last > last_step) *last = last_step;
+}
+
+/**
+ * @brief Draw a line without selecting/deselecting the display
  * @param ili9341 Pointer to ILI9341 handle structure
  * @param x1 X coordinate of the start point
  * @param y1 Y coordinate of the start point
  * @param x2 X coordinate of the end point
  * @param y2 Y coordinate of the end point
  * @param color 16-bit line color in RGB565 format
+ * @note Run-slice rasterization of the Bresenham line: the pixel at step i of the major axis is at offset
+ * m = (2 * i * minor + major) / (2 * major) on the minor axis, so the steps of each run of the same m are computed
+ * directly and the run is sent as one horizontal (shallow lines) or vertical (steep lines) span. The range of steps on
+ * the clip rectangle is computed up front, parts of the line outside of it cost nothing.
  */
 static void ILI9341_DrawLineFast(
     ILI9341_HandleTypeDef* ili9341,
@@ -795,29 +2225,69 @@ static void ILI9341_DrawLineFast(
     uint16_t color
 ) {
     if (x1 == x2) {
-        ILI9341_FillRectangleFast(ili9341, x1, y1, 1, y2 - y1 + 1, color);
+        ILI9341_FillSpanFast(ili9341, x1, y1 < y2 ? y1 : y2, x1, y1 < y2 ? y2 : y1, color);
         return;
     } else if (y1 == y2) {
-        ILI9341_FillRectangleFast(ili9341, x1, y1, x2 - x1 + 1, 1, color);
+        ILI9341_FillSpanFast(ili9341, x1 < x2 ? x1 : x2, y1, x1 < x2 ? x2 : x1, y1, color);
         return;
     }
 
-    int16_t dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
-    int16_t dy = -abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
-    int16_t err = dx + dy, e2; /* error value e_xy */
+    bool steep = abs(y2 - y1) > abs(x2 - x1);
+    int32_t major_start = steep ? y1 : x1;
+    int32_t minor_start = steep ? x1 : y1;
+    int32_t major_step = (steep ? y2 > y1 : x2 > x1) ? 1 : -1;
+    int32_t minor_step = (steep ? x2 > x1 : y2 > y1) ? 1 : -1;
+    int64_t major = steep ? abs(y2 - y1) : abs(x2 - x1);
+    int64_t minor = steep ? abs(x2 - x1) : abs(y2 - y1);
+
+    // steps with the major coordinate inside the clip rectangle
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    int32_t first = 0;
+    int32_t last = major;
+    if (steep) {
+        ILI9341_ClipSteps(major_start, major_step, clip.y0, clip.y1, &first, &last);
+    } else {
+        ILI9341_ClipSteps(major_start, major_step, clip.x0, clip.x1, &first, &last);
+    }
 
-    while (true) {
-        ILI9341_DrawPixelFast(ili9341, x1, y1, color);
-        if (x1 == x2 && y1 == y2) break;
-        e2 = 2 * err;
-        if (e2 >= dy) { /* e_xy+e_x > 0 */
-            err += dy;
-            x1 += sx;
+    // steps with the minor coordinate inside the clip rectangle, the first step at offset m is
+    // (2m - 1) * major / (2 * minor) rounded up
+    int32_t minor_first = 0;
+    int32_t minor_last = minor;
+    if (steep) {
+        ILI9341_ClipSteps(minor_start, minor_step, clip.x0, clip.x1, &minor_first, &minor_last);
+    } else {
+        ILI9341_ClipSteps(minor_start, minor_step, clip.y0, clip.y1, &minor_first, &minor_last);
+    }
+    if (minor_first > minor_last) return;
+    if (minor_first > 0) {
+        int32_t minor_first_step = ((2 * minor_first - 1) * major + 2 * minor - 1) / (2 * minor);
+        if (first < minor_first_step) first = minor_first_step;
+    }
+    int32_t minor_last_step = ((2 * minor_last + 1) * major + 2 * minor - 1) / (2 * minor) - 1;
+    if (last > minor_last_step) last = minor_last_step;
+
+    int64_t m = (2 * first * minor + major) / (2 * major);
+    while (first <= last) {
+        int32_t end = ((2 * m + 1) * major + 2 * minor - 1) / (2 * minor) - 1;
+        if (end > last) end = last;
+
+        int32_t a = major_start + major_step * first;
+        int32_t b = major_start + major_step * end;
+        int32_t c = minor_start + minor_step * m;
+        if (a > b) {
+            int32_t t = a;
+            a = b;
+            b = t;
         }
-        if (e2 <= dx) { /* e_xy+e_y < 0 */
-            err += dx;
-            y1 += sy;
+        if (steep) {
+            ILI9341_FillSpanFast(ili9341, c, a, c, b, color);
+        } else {
+            ILI9341_FillSpanFast(ili9341, a, c, b, c, color);
         }
+
+        first = end + 1;
+        m++;
     }
 }
 
@@ -841,45 +2311,18 @@ void ILI9341_DrawLineThick(
     if (thickness == 1) {
         ILI9341_DrawLine(ili9341, x1, y1, x2, y2, color);
         return;
-    }
-
-    // calculate line vector
-    int16_t dx = x2 - x1;
-    int16_t dy = y2 - y1;
-    float length = sqrtf(dx * dx + dy * dy);
-    if (length == 0) return;  // zero-length line
-
-    // unit vector
-    float ux = dx / length;
-    float uy = dy / length;
-
-    // perpendicular vector
-    float px = -uy;
-    float py = ux;
-
-    // half thickness
-    float half_thickness = thickness / 2.0f;
-
-    // calculate corner points
-    int16_t corners_x[4] = {
-        (int16_t)(x1 + px * half_thickness),
-        (int16_t)(x1 - px * half_thickness),
-        (int16_t)(x2 - px * half_thickness),
-        (int16_t)(x2 + px * half_thickness)
-    };
-    int16_t corners_y[4] = {
-        (int16_t)(y1 + py * half_thickness),
-        (int16_t)(y1 - py * half_thickness),
-        (int16_t)(y2 - py * half_thickness),
-        (int16_t)(y2 + py * half_thickness)
-    };
+    }
+    if (x1 == x2 && y1 == y2) return;  // zero-length line
 
-    ILI9341_FillPolygon(ili9341, corners_x, corners_y, 4, color);
+    struct {
+        ILI9341_PolygonEdgeTypeDef edges[ILI9341_POLYGON_STACK_EDGES];
+        uint16_t active[ILI9341_POLYGON_STACK_EDGES];
+    } scratch;
+    int16_t x[] = {x1, x2};
+    int16_t y[] = {y1, y2};
+    uint8_t join = cap ? ILI9341_JOIN_ROUND : ILI9341_JOIN_MITER;
 
-    if (cap) {
-        ILI9341_FillCircle(ili9341, x1, y1, half_thickness, color);
-        ILI9341_FillCircle(ili9341, x2, y2, half_thickness, color);
-    }
+    ILI9341_DrawPolylineThick(ili9341, x, y, 2, color, thickness, join, false, &scratch, sizeof(scratch));
 }
 
 void ILI9341_DrawRectangle(ILI9341_HandleTypeDef* ili9341, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
@@ -907,19 +2350,47 @@ void ILI9341_DrawRectangleThick(
     ILI9341_Deselect(ili9341);
 }
 
+/**
+ * @brief Fill the pixels of a circle outline a run of the first octant stands for
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param xc X coordinate of the center of the circle
+ * @param yc Y coordinate of the center of the circle
+ * @param x0 First x offset of the run
+ * @param x1 Last x offset of the run
+ * @param y Y offset of the run, x1 <= y
+ * @param color 16-bit circle color in RGB565 format
+ * @note The run is sent as horizontal spans on rows yc +- y, its reflection across the diagonal as vertical spans on
+ * columns xc +- y. The diagonal pixel belongs to the horizontal spans only.
+ */
+static void ILI9341_DrawCircleRun(
+    ILI9341_HandleTypeDef* ili9341,
+    int16_t xc,
+    int16_t yc,
+    int32_t x0,
+    int32_t x1,
+    int32_t y,
+    uint16_t color
+) {
+    ILI9341_FillMirroredFast(ili9341, xc, yc, x0, x1, y, y, color);
+    if (x1 == y) x1--;
+    if (x0 <= x1) ILI9341_FillMirroredFast(ili9341, xc, yc, y, y, x0, x1, color);
+}
+
 void ILI9341_DrawCircle(ILI9341_HandleTypeDef* ili9341, int16_t xc, int16_t yc, uint16_t r, uint16_t color) {
-    int16_t f = 1 - r;
-    int16_t ddF_x = 1;
-    int16_t ddF_y = -2 * r;
-    int16_t x = 0;
-    int16_t y = r;
+    if (!ILI9341_ClipBox(ili9341, xc - r, yc - r, 2 * r + 1, 2 * r + 1, NULL)) return;
 
-    ILI9341_Select(ili9341);
+    int32_t f = 1 - r;
+    int32_t ddF_x = 1;
+    int32_t ddF_y = -2 * r;
+    int32_t x = 0;
+    int32_t y = r;
+
+    // pixels of the first octant (0 <= x <= y) on the same row form a run, sent as one span per octant
+    int32_t run_x0 = 0;
+    int32_t run_x1 = 0;
+    int32_t run_y = r;
 
-    ILI9341_DrawPixelFast(ili9341, xc, yc + r, color);
-    ILI9341_DrawPixelFast(ili9341, xc, yc - r, color);
-    ILI9341_DrawPixelFast(ili9341, xc + r, yc, color);
-    ILI9341_DrawPixelFast(ili9341, xc - r, yc, color);
+    ILI9341_Select(ili9341);
 
     while (x < y) {
         if (f >= 0) {
@@ -931,15 +2402,17 @@ void ILI9341_DrawCircle(ILI9341_HandleTypeDef* ili9341, int16_t xc, int16_t yc,
         ddF_x += 2;
         f += ddF_x;
 
-        ILI9341_DrawPixelFast(ili9341, xc + x, yc + y, color);
-        ILI9341_DrawPixelFast(ili9341, xc - x, yc + y, color);
-        ILI9341_DrawPixelFast(ili9341, xc + x, yc - y, color);
-        ILI9341_DrawPixelFast(ili9341, xc - x, yc - y, color);
-        ILI9341_DrawPixelFast(ili9341, xc + y, yc + x, color);
-        ILI9341_DrawPixelFast(ili9341, xc - y, yc + x, color);
-        ILI9341_DrawPixelFast(ili9341, xc + y, yc - x, color);
-        ILI9341_DrawPixelFast(ili9341, xc - y, yc - x, color);
+        // past the diagonal the pixel is the reflection of one of the previous run
+        if (x > y) break;
+
+        if (y != run_y) {
+            ILI9341_DrawCircleRun(ili9341, xc, yc, run_x0, run_x1, run_y, color);
+            run_x0 = x;
+            run_y = y;
+        }
+        run_x1 = x;
     }
+    ILI9341_DrawCircleRun(ili9341, xc, yc, run_x0, run_x1, run_y, color);
 
     ILI9341_Deselect(ili9341);
 }
@@ -952,42 +2425,64 @@ void ILI9341_DrawCircleThick(
     uint16_t color,
     uint16_t thickness
 ) {
-    if (thickness == 0) return;
+    if (thickness == 0 || !ILI9341_ClipBox(ili9341, xc - r, yc - r, 2 * r + 1, 2 * r + 1, NULL)) return;
     if (thickness > r) thickness = r;
     if (thickness == 1) {
         ILI9341_DrawCircle(ili9341, xc, yc, r, color);
         return;
     }
 
-    uint16_t r_inner = r - thickness;
-    uint16_t x_outer = r;
-    uint16_t x_inner = r_inner;
+    uint32_t r_inner = r - thickness;
+    uint32_t x_outer = r;
+    uint32_t x_inner = r_inner;
+
+    // rows with the same span are sent together, rows past the inner circle are full rows
+    uint32_t band_y = 0;
+    uint32_t band_inner = 0;
+    uint32_t band_outer = 0;
 
     ILI9341_Select(ili9341);
 
-    for (int16_t y = 0; y <= r; y++) {
-        while (x_outer * x_outer + y * y > r * r) { x_outer--; }
-        while (x_inner * x_inner + y * y > r_inner * r_inner) { x_inner--; }
+    for (uint32_t y = 0; y <= r; y++) {
+        while (x_outer * x_outer + y * y > (uint32_t)r * r) { x_outer--; }
+        if (y > r_inner) {
+            x_inner = 0;
+        } else {
+            while (x_inner * x_inner + y * y > r_inner * r_inner) { x_inner--; }
+        }
 
-        ILI9341_DrawLineFast(ili9341, xc - x_outer, yc + y, xc - x_inner, yc + y, color);
-        ILI9341_DrawLineFast(ili9341, xc + x_inner, yc + y, xc + x_outer, yc + y, color);
-        ILI9341_DrawLineFast(ili9341, xc - x_outer, yc - y, xc - x_inner, yc - y, color);
-        ILI9341_DrawLineFast(ili9341, xc + x_inner, yc - y, xc + x_outer, yc - y, color);
+        if (y > 0 && (x_inner != band_inner || x_outer != band_outer)) {
+            ILI9341_FillMirroredFast(ili9341, xc, yc, band_inner, band_outer, band_y, y - 1, color);
+            band_y = y;
+        }
+        band_inner = x_inner;
+        band_outer = x_outer;
     }
+    ILI9341_FillMirroredFast(ili9341, xc, yc, band_inner, band_outer, band_y, r, color);
 
     ILI9341_Deselect(ili9341);
 }
 
 void ILI9341_FillCircle(ILI9341_HandleTypeDef* ili9341, int16_t xc, int16_t yc, uint16_t r, uint16_t color) {
-    uint16_t x = r;
+    if (!ILI9341_ClipBox(ili9341, xc - r, yc - r, 2 * r + 1, 2 * r + 1, NULL)) return;
+
+    uint32_t x = r;
+
+    // rows of the same width are sent as one rectangle
+    uint32_t band_y = 0;
+    uint32_t band_x = r;
 
     ILI9341_Select(ili9341);
 
-    for (uint16_t y = 0; y <= r; y++) {
-        while (x * x + y * y > r * r) { x--; }
-        ILI9341_DrawLineFast(ili9341, xc - x, yc + y, xc + x, yc + y, color);
-        ILI9341_DrawLineFast(ili9341, xc - x, yc - y, xc + x, yc - y, color);
+    for (uint32_t y = 0; y <= r; y++) {
+        while (x * x + y * y > (uint32_t)r * r) { x--; }
+        if (x != band_x) {
+            ILI9341_FillMirroredFast(ili9341, xc, yc, 0, band_x, band_y, y - 1, color);
+            band_y = y;
+            band_x = x;
+        }
     }
+    ILI9341_FillMirroredFast(ili9341, xc, yc, 0, band_x, band_y, r, color);
 
     ILI9341_Deselect(ili9341);
 }
@@ -1018,72 +2513,1010 @@ void ILI9341_DrawPolygonThick(
         return;
     }
 
-    for (uint16_t i = 0; i < n - 1; i++) {
-        ILI9341_DrawLineThick(ili9341, x[i], y[i], x[i + 1], y[i + 1], color, thickness, cap);
-    }
-    ILI9341_DrawLineThick(ili9341, x[n - 1], y[n - 1], x[0], y[0], color, thickness, cap);
+    struct {
+        ILI9341_PolygonEdgeTypeDef edges[ILI9341_POLYGON_STACK_EDGES];
+        uint16_t active[ILI9341_POLYGON_STACK_EDGES];
+    } scratch;
+    uint8_t join = cap ? ILI9341_JOIN_ROUND : ILI9341_JOIN_MITER;
+
+    ILI9341_DrawPolylineThick(ili9341, x, y, n, color, thickness, join, true, &scratch, sizeof(scratch));
 }
 
-void ILI9341_FillPolygon(ILI9341_HandleTypeDef* ili9341, int16_t* x, int16_t* y, uint16_t n, uint16_t color) {
-    if (n < 3) return;
+/**
+ * @brief Divide by a power of two, rounding down also for negative values
+ * @param value Value to divide
+ * @param shift Power of two to divide by
+ * @return value / 2^shift rounded down
+ */
+static int32_t ILI9341_FloorShift(int32_t value, uint8_t shift) {
+    return value >= 0 ? value >> shift : -((-value + (1 << shift) - 1) >> shift);
+}
 
-    // find max and min Y
-    int16_t minY = y[0], maxY = y[0];
-    for (uint16_t i = 1; i < n; i++) {
-        if (y[i] < minY) minY = y[i];
-        if (y[i] > maxY) maxY = y[i];
+/**
+ * @brief Sort polygon edges by their first scanline, in place (shell sort)
+ * @param edges Array of edges
+ * @param count Number of edges
+ */
+static void ILI9341_SortPolygonEdges(ILI9341_PolygonEdgeTypeDef* edges, uint16_t count) {
+    for (uint16_t gap = count / 2; gap > 0; gap /= 2) {
+        for (uint16_t i = gap; i < count; i++) {
+            ILI9341_PolygonEdgeTypeDef edge = edges[i];
+            uint16_t j = i;
+            while (j >= gap && edges[j - gap].y_start > edge.y_start) {
+                edges[j] = edges[j - gap];
+                j -= gap;
+            }
+            edges[j] = edge;
+        }
     }
+}
+
+/**
+ * @brief Set up the edge of a polygon between two vertices, at its first scanline inside the clip rectangle
+ * @param edge Pointer to the edge
+ * @param x1 X coordinate of the first vertex
+ * @param y1 Y coordinate of the first vertex
+ * @param x2 X coordinate of the second vertex
+ * @param y2 Y coordinate of the second vertex, different from y1
+ * @param top First scanline of the clip rectangle
+ * @param bottom Last scanline of the clip rectangle
+ * @param shift 0 for vertices in pixels, crossing the scanlines below the top vertex down to the bottom vertex
+ * included, else the number of fractional bits of the vertices, crossing the scanlines whose pixel centers are in
+ * [top, bottom)
+ * @return true if the edge crosses scanlines of the clip rectangle
+ */
+static bool ILI9341_InitPolygonEdge(
+    ILI9341_PolygonEdgeTypeDef* edge,
+    int32_t x1,
+    int32_t y1,
+    int32_t x2,
+    int32_t y2,
+    int32_t top,
+    int32_t bottom,
+    uint8_t shift
+) {
+    edge->winding = y2 > y1 ? 1 : -1;
+    int32_t x_top = y2 > y1 ? x1 : x2;
+    int32_t y_top = y2 > y1 ? y1 : y2;
+    int32_t y_bottom = y2 > y1 ? y2 : y1;
+    int32_t dx = (y2 > y1 ? x2 : x1) - x_top;
+
+    int32_t center = shift ? 1 << (shift - 1) : 0;
+    int32_t y_start = shift ? -ILI9341_FloorShift(center - y_top, shift) : y_top + 1;
+    int32_t y_end = shift ? -ILI9341_FloorShift(center - y_bottom, shift) - 1 : y_bottom;
+    if (y_start < top) y_start = top;
+    if (y_end > bottom) y_end = bottom;
+    if (y_start > y_end) return false;
+
+    // x = x_top + (y - y_top) * dx / dy rounded down, as a whole part and a remainder in [0, dy)
+    int32_t dy = y_bottom - y_top;
+    int32_t step = dx * (1 << shift);
+    int64_t offset = (int64_t)((y_start << shift) + center - y_top) * dx;
+    int64_t offset_whole = offset >= 0 ? offset / dy : -((-offset + dy - 1) / dy);
+    int32_t step_whole = step >= 0 ? step / dy : -((-step + dy - 1) / dy);
+
+    edge->x = x_top + (int32_t)offset_whole;
+    edge->error = (int32_t)(offset - offset_whole * dy);
+    edge->x_step = step_whole;
+    edge->error_step = step - step_whole * dy;
+    edge->dy = dy;
+    edge->y_start = y_start;
+    edge->y_end = y_end;
+    return true;
+}
 
-    if (minY >= ili9341->height) return;
-    if (maxY < 0) return;
-    if (minY < 0) minY = 0;
-    if (maxY >= ili9341->height) maxY = ili9341->height - 1;
+/**
+ * @brief Fill the inside of an edge table scanline by scanline, keeping an active edge list
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param edges Edges set up by ILI9341_InitPolygonEdge, sorted in place
+ * @param count Number of edges
+ * @param active Active edge list, room for count indices
+ * @param color 16-bit color in RGB565 format
+ * @param rule ILI9341_FILL_RULE_EVEN_ODD or ILI9341_FILL_RULE_NON_ZERO
+ * @param shift Number of fractional bits of the edges, as given to ILI9341_InitPolygonEdge
+ * @note With whole pixel edges spans include both crossings, with fractional edges the pixels whose center is in
+ * [left, right).
+ */
+static void ILI9341_FillPolygonEdges(
+    ILI9341_HandleTypeDef* ili9341,
+    ILI9341_PolygonEdgeTypeDef* edges,
+    uint16_t count,
+    uint16_t* active,
+    uint16_t color,
+    uint8_t rule,
+    uint8_t shift
+) {
+    if (count == 0) return;
 
-    int16_t nodeX[32];  // max 32 intersections
+    ILI9341_SortPolygonEdges(edges, count);
 
-    ILI9341_Select(ili9341);
+    int32_t center = shift ? 1 << (shift - 1) : 0;
+    uint16_t active_count = 0;
+    uint16_t next = 0;
 
-    // scanline algorithm
-    for (uint16_t j = minY; j <= maxY; j++) {
-        uint16_t nodes = 0;
-        uint16_t k = n - 1;
+    ILI9341_Select(ili9341);
 
-        // find intersections
-        for (uint16_t i = 0; i < n; i++) {
-            if ((y[i] < j && y[k] >= j) || (y[k] < j && y[i] >= j)) {
-                int16_t dy = y[k] - y[i];
-                if (dy != 0 && nodes < 32) { nodeX[nodes++] = x[i] + ((int32_t)(j - y[i]) * (x[k] - x[i])) / dy; }
+    for (int32_t j = edges[0].y_start; active_count > 0 || next < count; j++) {
+        if (active_count == 0) j = edges[next].y_start;
+        while (next < count && edges[next].y_start == j) { active[active_count++] = next++; }
+
+        // x only changes a little from one scanline to the next, insertion sort is close to linear
+        for (uint16_t i = 1; i < active_count; i++) {
+            uint16_t edge = active[i];
+            uint16_t k = i;
+            while (k > 0 && edges[active[k - 1]].x > edges[edge].x) {
+                active[k] = active[k - 1];
+                k--;
             }
-            k = i;
+            active[k] = edge;
         }
 
-        // insertion sort nodeX array
-        for (uint16_t i = 1; i < nodes; i++) {
-            int16_t key = nodeX[i];
-            int16_t j_sort = i - 1;
-            while (j_sort >= 0 && nodeX[j_sort] > key) {
-                nodeX[j_sort + 1] = nodeX[j_sort];
-                j_sort--;
+        // fill between the crossings where the rule says the inside starts and ends, touching spans are merged
+        int32_t inside = 0;
+        int32_t span_x0 = 0;
+        int32_t span_x1 = 0;
+        int32_t start = 0;
+        bool span = false;
+        for (uint16_t i = 0; i < active_count; i++) {
+            const ILI9341_PolygonEdgeTypeDef* edge = &edges[active[i]];
+            bool was_inside = inside != 0;
+            inside = rule == ILI9341_FILL_RULE_NON_ZERO ? inside + edge->winding : !inside;
+
+            if (!was_inside && inside != 0) {
+                start = shift ? -ILI9341_FloorShift(center - edge->x, shift) : edge->x;
+            } else if (was_inside && inside == 0) {
+                int32_t end = shift ? -ILI9341_FloorShift(center - edge->x, shift) - 1 : edge->x;
+                if (end < start) continue;
+
+                if (span && start <= span_x1 + 1) {
+                    if (end > span_x1) span_x1 = end;
+                } else {
+                    if (span) ILI9341_FillSpanFast(ili9341, span_x0, j, span_x1, j, color);
+                    span_x0 = start;
+                    span_x1 = end;
+                    span = true;
+                }
+            }
+        }
+        if (span) ILI9341_FillSpanFast(ili9341, span_x0, j, span_x1, j, color);
+
+        // step the edges to the next scanline, dropping the ones ending here
+        uint16_t kept = 0;
+        for (uint16_t i = 0; i < active_count; i++) {
+            ILI9341_PolygonEdgeTypeDef* edge = &edges[active[i]];
+            if (edge->y_end == j) continue;
+
+            edge->x += edge->x_step;
+            edge->error += edge->error_step;
+            if (edge->error >= edge->dy) {
+                edge->x++;
+                edge->error -= edge->dy;
             }
-            nodeX[j_sort + 1] = key;
+            active[kept++] = active[i];
         }
+        active_count = kept;
+    }
+
+    ILI9341_Deselect(ili9341);
+}
 
-        // fill the pixels between node pairs
-        for (uint16_t i = 0; i < nodes - 1; i += 2) {
-            int16_t x1 = nodeX[i];
-            int16_t x2 = nodeX[i + 1];
+/**
+ * @brief Set up the edges of a polygon crossing a band of scanlines
+ * @param x Array of X coordinates of the polygon vertices
+ * @param y Array of Y coordinates of the polygon vertices
+ * @param n Number of vertices in the polygon
+ * @param top First scanline of the band
+ * @param bottom Last scanline of the band
+ * @param edges Edge table, the first capacity edges crossing the band are stored
+ * @param capacity Number of edges in the table
+ * @return Number of edges crossing the band, can be more than capacity
+ */
+static uint16_t ILI9341_PolygonBandEdges(
+    const int16_t* x,
+    const int16_t* y,
+    uint16_t n,
+    int32_t top,
+    int32_t bottom,
+    ILI9341_PolygonEdgeTypeDef* edges,
+    uint16_t capacity
+) {
+    ILI9341_PolygonEdgeTypeDef unused;
+    uint16_t count = 0;
+    for (uint16_t i = 0, k = n - 1; i < n; k = i++) {
+        if (y[i] == y[k]) continue;
 
-            if (x1 >= ili9341->width) break;
-            if (x2 >= ili9341->width) x2 = ili9341->width - 1;
-            if (x1 < ili9341->width && x2 > 0 && x2 >= x1) {
-                ILI9341_FillRectangleFast(ili9341, x1, j, x2 - x1 + 1, 1, color);
+        ILI9341_PolygonEdgeTypeDef* edge = count < capacity ? &edges[count] : &unused;
+        if (ILI9341_InitPolygonEdge(edge, x[k], y[k], x[i], y[i], top, bottom, 0)) count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Fill a scanline of a polygon crossing it more times than the edge table holds, with the even-odd rule
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x Array of X coordinates of the polygon vertices
+ * @param y Array of Y coordinates of the polygon vertices
+ * @param n Number of vertices in the polygon
+ * @param j Scanline to fill
+ * @param color 16-bit polygon color in RGB565 format
+ * @param edges Edge table, holds the crossings of a pass
+ * @param indices Vertex index of the crossing edge of each entry of the table
+ * @param capacity Number of entries in the edge table
+ * @note The crossings are taken from left to right, capacity of them per pass over the edges, ordered by x then by
+ * vertex index so that crossings at the same x are each taken once.
+ */
+static void ILI9341_FillPolygonScanline(
+    ILI9341_HandleTypeDef* ili9341,
+    const int16_t* x,
+    const int16_t* y,
+    uint16_t n,
+    int32_t j,
+    uint16_t color,
+    ILI9341_PolygonEdgeTypeDef* edges,
+    uint16_t* indices,
+    uint16_t capacity
+) {
+    int32_t last_x = INT32_MIN;
+    int32_t last_index = -1;
+    bool inside = false;
+    int32_t start = 0;
+
+    for (;;) {
+        // the capacity leftmost crossings after the last one taken, kept sorted
+        uint16_t count = 0;
+        for (uint16_t i = 0, k = n - 1; i < n; k = i++) {
+            ILI9341_PolygonEdgeTypeDef edge;
+            if (y[i] == y[k] || !ILI9341_InitPolygonEdge(&edge, x[k], y[k], x[i], y[i], j, j, 0)) continue;
+            if (edge.x < last_x || (edge.x == last_x && i <= last_index)) continue;
+
+            uint16_t slot = count;
+            while (slot > 0 && (edges[slot - 1].x > edge.x || (edges[slot - 1].x == edge.x && indices[slot - 1] > i))) {
+                slot--;
+            }
+            if (slot == capacity) continue;
+
+            uint16_t moved = count < capacity ? count : capacity - 1;
+            memmove(&edges[slot + 1], &edges[slot], (moved - slot) * sizeof(edges[0]));
+            memmove(&indices[slot + 1], &indices[slot], (moved - slot) * sizeof(indices[0]));
+            edges[slot] = edge;
+            indices[slot] = i;
+            if (count < capacity) count++;
+        }
+        if (count == 0) return;
+
+        // spans include both crossings, as in ILI9341_FillPolygonEdges
+        for (uint16_t i = 0; i < count; i++) {
+            if (!inside) {
+                start = edges[i].x;
+            } else if (edges[i].x >= start) {
+                ILI9341_FillSpanFast(ili9341, start, j, edges[i].x, j, color);
             }
+            inside = !inside;
+        }
+        last_x = edges[count - 1].x;
+        last_index = indices[count - 1];
+    }
+}
+
+void ILI9341_FillPolygon(ILI9341_HandleTypeDef* ili9341, int16_t* x, int16_t* y, uint16_t n, uint16_t color) {
+    struct {
+        ILI9341_PolygonEdgeTypeDef edges[ILI9341_POLYGON_STACK_EDGES];
+        uint16_t active[ILI9341_POLYGON_STACK_EDGES];
+    } scratch;
+
+    if (ILI9341_FillPolygonWithRule(ili9341, x, y, n, color, ILI9341_FILL_RULE_EVEN_ODD, &scratch, sizeof(scratch))) {
+        return;
+    }
+
+    // too many edges for the table, filled in bands of scanlines halved until the edges crossing them fit
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    for (int32_t top = clip.y0, bottom; top <= clip.y1; top = bottom + 1) {
+        bottom = clip.y1;
+        uint16_t count;
+        while ((count = ILI9341_PolygonBandEdges(x, y, n, top, bottom, scratch.edges, ILI9341_POLYGON_STACK_EDGES)) >
+                   ILI9341_POLYGON_STACK_EDGES &&
+               bottom > top) {
+            bottom = top + (bottom - top) / 2;
+        }
+
+        if (count <= ILI9341_POLYGON_STACK_EDGES) {
+            ILI9341_FillPolygonEdges(
+                ili9341,
+                scratch.edges,
+                count,
+                scratch.active,
+                color,
+                ILI9341_FILL_RULE_EVEN_ODD,
+                0
+            );
+        } else {
+            ILI9341_Select(ili9341);
+            ILI9341_FillPolygonScanline(
+                ili9341,
+                x,
+                y,
+                n,
+                top,
+                color,
+                scratch.edges,
+                scratch.active,
+                ILI9341_POLYGON_STACK_EDGES
+            );
+            ILI9341_Deselect(ili9341);
+        }
+    }
+}
+
+bool ILI9341_FillPolygonWithRule(
+    ILI9341_HandleTypeDef* ili9341,
+    const int16_t* x,
+    const int16_t* y,
+    uint16_t n,
+    uint16_t color,
+    uint8_t rule,
+    void* scratch,
+    size_t scratch_size
+) {
+    if (n < 3) return true;
+
+    // edge table, the edges crossing scanlines of the clip rectangle
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(ili9341);
+    ILI9341_PolygonEdgeTypeDef* edges = scratch;
+    uint16_t edge_count = 0;
+    int16_t x_min = x[0];
+    int16_t x_max = x[0];
+    for (uint16_t i = 0, k = n - 1; i < n; k = i++) {
+        if (x[i] < x_min) x_min = x[i];
+        if (x[i] > x_max) x_max = x[i];
+        if (y[i] == y[k]) continue;
+
+        if ((size_t)(edge_count + 1) * sizeof(ILI9341_PolygonEdgeTypeDef) > scratch_size) return false;
+        ILI9341_PolygonEdgeTypeDef* edge = &edges[edge_count];
+        if (ILI9341_InitPolygonEdge(edge, x[k], y[k], x[i], y[i], clip.y0, clip.y1, 0)) edge_count++;
+    }
+    if (ILI9341_POLYGON_SCRATCH_SIZE(edge_count) > scratch_size) return false;
+    if (x_max < clip.x0 || x_min > clip.x1) return true;
+
+    ILI9341_FillPolygonEdges(ili9341, edges, edge_count, (uint16_t*)(edges + edge_count), color, rule, 0);
+    return true;
+}
+
+/**
+ * @brief Fill the pieces collected so far and empty the edge table
+ * @param stroke Pointer to the stroke
+ */
+static void ILI9341_StrokeFlush(ILI9341_StrokeTypeDef* stroke) {
+    ILI9341_FillPolygonEdges(
+        stroke->ili9341,
+        stroke->edges,
+        stroke->count,
+        stroke->active,
+        stroke->color,
+        ILI9341_FILL_RULE_NON_ZERO,
+        ILI9341_STROKE_SUBPIXEL_BITS
+    );
+    stroke->count = 0;
+}
+
+/**
+ * @brief Add a closed piece of outline to a stroke
+ * @param stroke Pointer to the stroke
+ * @param x X coordinates of the piece vertices, in subpixels
+ * @param y Y coordinates of the piece vertices, in subpixels
+ * @param n Number of vertices, at most ILI9341_STROKE_PIECE_EDGES
+ * @note Pieces are oriented the same way whatever the order of their vertices, so the non-zero rule fills their union
+ * and the overlaps of a stroke are sent once.
+ */
+static void ILI9341_StrokeAddPiece(ILI9341_StrokeTypeDef* stroke, const int32_t* x, const int32_t* y, uint8_t n) {
+    int64_t area = 0;
+    int32_t x_min = x[0], x_max = x[0];
+    int32_t y_min = y[0], y_max = y[0];
+    for (uint8_t i = 0, k = n - 1; i < n; k = i++) {
+        area += (int64_t)x[k] * y[i] - (int64_t)x[i] * y[k];
+        if (x[i] < x_min) x_min = x[i];
+        if (x[i] > x_max) x_max = x[i];
+        if (y[i] < y_min) y_min = y[i];
+        if (y[i] > y_max) y_max = y[i];
+    }
+    if (area == 0) return;
+
+    // pieces outside of the clip rectangle are dropped, no pixel center of the clip rectangle is inside them
+    ILI9341_RectTypeDef clip = ILI9341_ClipRect(stroke->ili9341);
+    if (ILI9341_FloorShift(x_max, ILI9341_STROKE_SUBPIXEL_BITS) < clip.x0) return;
+    if (ILI9341_FloorShift(x_min, ILI9341_STROKE_SUBPIXEL_BITS) > clip.x1) return;
+    if (ILI9341_FloorShift(y_max, ILI9341_STROKE_SUBPIXEL_BITS) < clip.y0) return;
+    if (ILI9341_FloorShift(y_min, ILI9341_STROKE_SUBPIXEL_BITS) > clip.y1) return;
+
+    if (stroke->count + n > stroke->capacity) ILI9341_StrokeFlush(stroke);
+
+    for (uint8_t i = 0, k = n - 1; i < n; k = i++) {
+        if (y[i] == y[k]) continue;
+
+        ILI9341_PolygonEdgeTypeDef* edge = &stroke->edges[stroke->count];
+        if (ILI9341_InitPolygonEdge(edge, x[k], y[k], x[i], y[i], clip.y0, clip.y1, ILI9341_STROKE_SUBPIXEL_BITS)) {
+            if (area < 0) edge->winding = -edge->winding;
+            stroke->count++;
+        }
+    }
+}
+
+/**
+ * @brief Round a Q14 fixed point product to an integer
+ * @param value Product of a value and a Q14 factor
+ * @return Rounded value
+ */
+static int32_t ILI9341_RoundQ14(int64_t value) {
+    return (int32_t)(value >= 0 ? (value + 8192) >> 14 : -((-value + 8192) >> 14));
+}
+
+/**
+ * @brief Append the points of an arc around a vertex, between two offsets of the same length, both excluded
+ * @param x X coordinates of the piece being built, in subpixels
+ * @param y Y coordinates of the piece being built, in subpixels
+ * @param n Number of vertices of the piece, updated
+ * @param cx X coordinate of the center of the arc, in subpixels
+ * @param cy Y coordinate of the center of the arc, in subpixels
+ * @param vx X of the offset the arc starts at
+ * @param vy Y of the offset the arc starts at
+ * @param ex X of the offset the arc ends at
+ * @param ey Y of the offset the arc ends at
+ * @param dir 1 to turn from x toward y, -1 the other way
+ * @param steps Number of points per quarter turn, from 1 to ILI9341_STROKE_ARC_STEPS
+ */
+static void ILI9341_StrokeArc(
+    int32_t* x,
+    int32_t* y,
+    uint8_t* n,
+    int32_t cx,
+    int32_t cy,
+    int32_t vx,
+    int32_t vy,
+    int32_t ex,
+    int32_t ey,
+    int8_t dir,
+    uint8_t steps
+) {
+    // cosine and sine of a quarter turn divided by 1 to ILI9341_STROKE_ARC_STEPS, Q14
+    static const int16_t cosines[ILI9341_STROKE_ARC_STEPS] = {0, 11585, 14189, 15137, 15582, 15826};
+    static const int16_t sines[ILI9341_STROKE_ARC_STEPS] = {16384, 11585, 8192, 6270, 5063, 4240};
+    int32_t c = cosines[steps - 1];
+    int32_t s = sines[steps - 1] * dir;
+
+    for (uint8_t i = 1; i < steps * 2; i++) {
+        int32_t rx = ILI9341_RoundQ14((int64_t)vx * c - (int64_t)vy * s);
+        int32_t ry = ILI9341_RoundQ14((int64_t)vx * s + (int64_t)vy * c);
+        vx = rx;
+        vy = ry;
+
+        // stop once the end offset is reached, it is a vertex of the piece already
+        int64_t cross = ((int64_t)vx * ey - (int64_t)vy * ex) * dir;
+        int64_t dot = (int64_t)vx * ex + (int64_t)vy * ey;
+        if (cross <= 0 && dot > 0) break;
+
+        x[*n] = cx + vx;
+        y[*n] = cy + vy;
+        (*n)++;
+    }
+}
+
+/**
+ * @brief Add a round cap to a stroke, half a circle around an end of the polyline
+ * @param stroke Pointer to the stroke
+ * @param cx X coordinate of the end, in subpixels
+ * @param cy Y coordinate of the end, in subpixels
+ * @param nx X of the offset to the left side of the segment
+ * @param ny Y of the offset to the left side of the segment
+ * @param dir 1 for the start of the polyline, -1 for its end
+ * @param steps Number of arc points per quarter turn
+ */
+static void ILI9341_StrokeCap(
+    ILI9341_StrokeTypeDef* stroke,
+    int32_t cx,
+    int32_t cy,
+    int32_t nx,
+    int32_t ny,
+    int8_t dir,
+    uint8_t steps
+) {
+    int32_t x[ILI9341_STROKE_PIECE_EDGES];
+    int32_t y[ILI9341_STROKE_PIECE_EDGES];
+    uint8_t n = 0;
+
+    x[n] = cx;
+    y[n++] = cy;
+    x[n] = cx + nx;
+    y[n++] = cy + ny;
+    ILI9341_StrokeArc(x, y, &n, cx, cy, nx, ny, -nx, -ny, dir, steps);
+    x[n] = cx - nx;
+    y[n++] = cy - ny;
+
+    ILI9341_StrokeAddPiece(stroke, x, y, n);
+}
+
+/**
+ * @brief Add the join between two segments to a stroke, filling the gap on the outer side of the turn
+ * @param stroke Pointer to the stroke
+ * @param cx X coordinate of the vertex, in subpixels
+ * @param cy Y coordinate of the vertex, in subpixels
+ * @param n1x X of the offset to the left side of the incoming segment
+ * @param n1y Y of the offset to the left side of the incoming segment
+ * @param n2x X of the offset to the left side of the outgoing segment
+ * @param n2y Y of the offset to the left side of the outgoing segment
+ * @param half Half the thickness, the length of the offsets
+ * @param join One of ILI9341_JOIN_* values
+ * @param steps Number of arc points per quarter turn
+ */
+static void ILI9341_StrokeJoin(
+    ILI9341_StrokeTypeDef* stroke,
+    int32_t cx,
+    int32_t cy,
+    int32_t n1x,
+    int32_t n1y,
+    int32_t n2x,
+    int32_t n2y,
+    int32_t half,
+    uint8_t join,
+    uint8_t steps
+) {
+    // the offsets turn like the segments, the outer side is away from the turn
+    int64_t cross = (int64_t)n1x * n2y - (int64_t)n1y * n2x;
+    int64_t dot = (int64_t)n1x * n2x + (int64_t)n1y * n2y;
+    if (cross == 0 && dot > 0) return;
+
+    int8_t dir = cross >= 0 ? 1 : -1;
+    int32_t o1x = -dir * n1x;
+    int32_t o1y = -dir * n1y;
+    int32_t o2x = -dir * n2x;
+    int32_t o2y = -dir * n2y;
+
+    int32_t x[ILI9341_STROKE_PIECE_EDGES];
+    int32_t y[ILI9341_STROKE_PIECE_EDGES];
+    uint8_t n = 0;
+
+    x[n] = cx;
+    y[n++] = cy;
+    x[n] = cx + o1x;
+    y[n++] = cy + o1y;
+
+    if (join == ILI9341_JOIN_ROUND) {
+        ILI9341_StrokeArc(x, y, &n, cx, cy, o1x, o1y, o2x, o2y, dir, steps);
+    } else if (join == ILI9341_JOIN_MITER) {
+        // the miter point is (o1 + o2) * half^2 / (half^2 + o1.o2), bevel when it is further than the limit
+        int64_t square = (int64_t)half * half;
+        int64_t denominator = square + dot;
+        if (denominator * ILI9341_STROKE_MITER_LIMIT * ILI9341_STROKE_MITER_LIMIT >= 2 * square) {
+            x[n] = cx + (int32_t)((o1x + o2x) * square / denominator);
+            y[n++] = cy + (int32_t)((o1y + o2y) * square / denominator);
+        }
+    }
+
+    x[n] = cx + o2x;
+    y[n++] = cy + o2y;
+
+    ILI9341_StrokeAddPiece(stroke, x, y, n);
+}
+
+/**
+ * @brief Divide rounding to the nearest integer, halves away from zero
+ * @param value Value to divide
+ * @param divisor Divisor, must be > 0
+ * @return Rounded quotient
+ */
+static int32_t ILI9341_RoundDivide(int64_t value, int64_t divisor) {
+    return (int32_t)(value >= 0 ? (value + divisor / 2) / divisor : -((-value + divisor / 2) / divisor));
+}
+
+/**
+ * @brief Integer square root
+ * @param value Value to take the square root of
+ * @return Square root of value rounded down
+ */
+static uint32_t ILI9341_SquareRoot(uint64_t value) {
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > value) bit >>= 2;
+
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+void ILI9341_DrawPolylineThick(
+    ILI9341_HandleTypeDef* ili9341,
+    const int16_t* x,
+    const int16_t* y,
+    uint16_t n,
+    uint16_t color,
+    uint16_t thickness,
+    uint8_t join,
+    bool closed,
+    void* scratch,
+    size_t scratch_size
+) {
+    size_t capacity = scratch_size / (sizeof(ILI9341_PolygonEdgeTypeDef) + sizeof(uint16_t));
+    if (n == 0 || thickness == 0 || capacity < ILI9341_STROKE_PIECE_EDGES) return;
+    if (capacity > UINT16_MAX) capacity = UINT16_MAX;
+
+    ILI9341_StrokeTypeDef stroke = {
+        .ili9341 = ili9341,
+        .edges = scratch,
+        .active = (uint16_t*)((ILI9341_PolygonEdgeTypeDef*)scratch + capacity),
+        .capacity = capacity,
+        .count = 0,
+        .color = color,
+    };
+
+    // vertices are at pixel centers, in subpixels
+    const int32_t one = 1 << ILI9341_STROKE_SUBPIXEL_BITS;
+    int32_t half = (int32_t)thickness << (ILI9341_STROKE_SUBPIXEL_BITS - 1);
+    uint8_t steps = 2 + thickness / 8 < ILI9341_STROKE_ARC_STEPS ? 2 + thickness / 8 : ILI9341_STROKE_ARC_STEPS;
+    uint16_t segments = closed ? n : n - 1;
+
+    int32_t first_nx = 0, first_ny = 0;
+    int32_t last_nx = 0, last_ny = 0;
+    int32_t first_x = 0, first_y = 0;
+    int32_t last_x = 0, last_y = 0;
+    bool drawn = false;
+
+    for (uint16_t i = 0; i < segments; i++) {
+        uint16_t k = i + 1 < n ? i + 1 : 0;
+        int32_t dx = x[k] - x[i];
+        int32_t dy = y[k] - y[i];
+        if (dx == 0 && dy == 0) continue;
+
+        // offset to the left side, half the thickness long, from a length with 8 fractional bits
+        uint32_t length = ILI9341_SquareRoot(((uint64_t)((int64_t)dx * dx + (int64_t)dy * dy)) << 16);
+        int32_t nx = ILI9341_RoundDivide((int64_t)-dy * half * 256, length);
+        int32_t ny = ILI9341_RoundDivide((int64_t)dx * half * 256, length);
+
+        int32_t ax = x[i] * one + one / 2;
+        int32_t ay = y[i] * one + one / 2;
+        int32_t bx = x[k] * one + one / 2;
+        int32_t by = y[k] * one + one / 2;
+
+        if (!drawn) {
+            first_nx = nx;
+            first_ny = ny;
+            first_x = ax;
+            first_y = ay;
+            drawn = true;
+        } else {
+            ILI9341_StrokeJoin(&stroke, ax, ay, last_nx, last_ny, nx, ny, half, join, steps);
+        }
+
+        int32_t quad_x[] = {ax + nx, bx + nx, bx - nx, ax - nx};
+        int32_t quad_y[] = {ay + ny, by + ny, by - ny, ay - ny};
+        ILI9341_StrokeAddPiece(&stroke, quad_x, quad_y, 4);
+
+        last_nx = nx;
+        last_ny = ny;
+        last_x = bx;
+        last_y = by;
+    }
+
+    if (!drawn) {
+        // a single point is a dot with round joins and nothing otherwise
+        if (join == ILI9341_JOIN_ROUND) {
+            int32_t cx = x[0] * one + one / 2;
+            int32_t cy = y[0] * one + one / 2;
+            ILI9341_StrokeCap(&stroke, cx, cy, 0, half, 1, steps);
+            ILI9341_StrokeCap(&stroke, cx, cy, 0, half, -1, steps);
+        }
+    } else if (closed) {
+        ILI9341_StrokeJoin(&stroke, first_x, first_y, last_nx, last_ny, first_nx, first_ny, half, join, steps);
+    } else if (join == ILI9341_JOIN_ROUND) {
+        ILI9341_StrokeCap(&stroke, first_x, first_y, first_nx, first_ny, 1, steps);
+        ILI9341_StrokeCap(&stroke, last_x, last_y, last_nx, last_ny, -1, steps);
+    }
+
+    ILI9341_StrokeFlush(&stroke);
+}
+
+
+/**
+ * @brief Blend a color over another one
+ * @param color 16-bit color in RGB565 format
+ * @param background 16-bit color it is blended over
+ * @param alpha Coverage of the pixel by color, 0 to 255
+ * @return Blended color in RGB565 format
+ * @note Green is moved to the upper half word, so that the 3 components are scaled together by a 5-bit alpha with a
+ * single multiply per color.
+ */
+static inline uint16_t ILI9341_Blend(uint16_t color, uint16_t background, uint8_t alpha) {
+    uint32_t a = ((uint32_t)alpha + 4) >> 3;
+    uint32_t fg = (color | (uint32_t)color << 16) & 0x07E0F81F;
+    uint32_t bg = (background | (uint32_t)background << 16) & 0x07E0F81F;
+    uint32_t blended = ((fg * a + bg * (32 - a)) >> 5) & 0x07E0F81F;
+    return blended | blended >> 16;
+}
+
+/**
+ * @brief Draw a run of an anti-aliased outline, steps along its major axis covering the same pair of pixels across it
+ * without selecting/deselecting the display
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param steep true if the major axis is y, the pairs are then on rows
+ * @param major Coordinate of the first step along the major axis, the following steps go up from it
+ * @param minor Coordinate of the first pixel of the pair along the minor axis, the second pixel is at minor + 1
+ * @param coverage Coverage of the second pixel at each step, 0 to 255, the first pixel is covered by the rest
+ * @param count Number of steps, at most ILI9341_AA_RUN_STEPS
+ * @param flags ILI9341_AA_RUN_* flags
+ * @param color 16-bit color in RGB565 format
+ * @param background Color blended with when no framebuffer is attached
+ * @note The run is a single address window of 2 rows (or columns) of count pixels, a pixel of the pair left without
+ * coverage for the whole run is left out of it. With a framebuffer attached the colors are blended with its pixels.
+ */
+static void ILI9341_DrawCoverageRun(
+    ILI9341_HandleTypeDef* ili9341,
+    bool steep,
+    int32_t major,
+    int32_t minor,
+    const uint8_t* coverage,
+    uint8_t count,
+    uint8_t flags,
+    uint16_t color,
+    uint16_t background
+) {
+    bool invert = flags & ILI9341_AA_RUN_INVERT;
+    bool first_covered = false;
+    bool second_covered = false;
+    for (uint8_t i = 0; i < count; i++) {
+        if (coverage[i] != (invert ? 0 : 255)) first_covered = true;
+        if (coverage[i] != (invert ? 255 : 0)) second_covered = true;
+    }
+    if (!first_covered) flags &= ~ILI9341_AA_RUN_FIRST;
+    if (!second_covered) flags &= ~ILI9341_AA_RUN_SECOND;
+    if (!(flags & (ILI9341_AA_RUN_FIRST | ILI9341_AA_RUN_SECOND))) return;
+
+    int32_t minor0 = flags & ILI9341_AA_RUN_FIRST ? minor : minor + 1;
+    int32_t minor1 = flags & ILI9341_AA_RUN_SECOND ? minor + 1 : minor;
+    int32_t x = steep ? minor0 : major;
+    int32_t y = steep ? major : minor0;
+    ILI9341_RectTypeDef visible;
+    if (!ILI9341_ClipBox(ili9341, x, y, steep ? minor1 - minor0 + 1 : count, steep ? count : minor1 - minor0 + 1,
+                         &visible)) {
+        return;
+    }
+
+    const ILI9341_FramebufferTypeDef* framebuffer = ili9341->framebuffer;
+    uint16_t buffer[2 * ILI9341_AA_RUN_STEPS];
+    uint16_t n = 0;
+    for (int32_t j = visible.y0; j <= visible.y1; j++) {
+        for (int32_t i = visible.x0; i <= visible.x1; i++) {
+            int32_t step = steep ? j : i;
+            if (flags & ILI9341_AA_RUN_REVERSE) step = count - 1 - step;
+            bool second = minor0 + (steep ? i : j) != minor;
+            uint8_t alpha = second != invert ? coverage[step] : 255 - coverage[step];
+
+            uint16_t under = background;
+            if (framebuffer) under = framebuffer->pixels[(uint32_t)(y + j) * framebuffer->width + x + i];
+            buffer[n++] = ILI9341_Blend(color, under, alpha);
+        }
+    }
+
+    ILI9341_SetAddressWindow(ili9341, x + visible.x0, y + visible.y0, x + visible.x1, y + visible.y1);
+    ILI9341_WritePixelData(ili9341, buffer, n);
+}
+
+/**
+ * @brief Draw an anti-aliased line without selecting/deselecting the display
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param x1 X coordinate of the start point
+ * @param y1 Y coordinate of the start point
+ * @param x2 X coordinate of the end point
+ * @param y2 Y coordinate of the end point
+ * @param color 16-bit line color in RGB565 format
+ * @param background Color blended with when no framebuffer is attached
+ * @note At each step along the major axis the line crosses a pair of pixels, each covered by the distance of the
+ * other one to the line, in 1/256 of a pixel. The position is stepped exactly, an integer part and a remainder of
+ * the major length, and steps crossing the same pair form a run sent as one address window.
+ */
+static void ILI9341_DrawLineAAFast(
+    ILI9341_HandleTypeDef* ili9341,
+    int16_t x1,
+    int16_t y1,
+    int16_t x2,
+    int16_t y2,
+    uint16_t color,
+    uint16_t background
+) {
+    bool steep = abs(y2 - y1) > abs(x2 - x1);
+    int32_t major1 = steep ? y1 : x1;
+    int32_t major2 = steep ? y2 : x2;
+    int32_t minor1 = steep ? x1 : y1;
+    int32_t minor2 = steep ? x2 : y2;
+    if (major1 > major2) {
+        int32_t t = major1;
+        major1 = major2;
+        major2 = t;
+        t = minor1;
+        minor1 = minor2;
+        minor2 = t;
+    }
+
+    int32_t length = major2 - major1;
+    int32_t rise = abs(minor2 - minor1);
+    int32_t direction = minor2 < minor1 ? -1 : 1;
+    int32_t low = minor1 < minor2 ? minor1 : minor2;
+    if (!ILI9341_ClipBox(ili9341, steep ? low : major1, steep ? major1 : low, steep ? rise + 2 : length + 1,
+                         steep ? length + 1 : rise + 2, NULL)) {
+        return;
+    }
+
+    // remainder / length of a pixel is 256 * remainder * scale >> 24
+    uint32_t scale = length ? ((uint32_t)256 << 16) / length : 0;
+    int32_t offset = 0;
+    int32_t remainder = 0;
+
+    uint8_t coverage[ILI9341_AA_RUN_STEPS];
+    uint8_t count = 0;
+    int32_t run_major = major1;
+    int32_t run_minor = 0;
+    for (int32_t major = major1; major <= major2; major++) {
+        // position along the minor axis in 1/256 of a pixel, the pair is the pixel below it and the next one
+        int32_t position = minor1 * 256 + direction * (offset * 256 + (int32_t)(((uint32_t)remainder * scale) >> 16));
+        int32_t minor = ILI9341_FloorShift(position, 8);
+        if (count > 0 && (minor != run_minor || count == ILI9341_AA_RUN_STEPS)) {
+            ILI9341_DrawCoverageRun(ili9341, steep, run_major, run_minor, coverage, count,
+                                    ILI9341_AA_RUN_FIRST | ILI9341_AA_RUN_SECOND, color, background);
+            count = 0;
+        }
+        if (count == 0) {
+            run_major = major;
+            run_minor = minor;
+        }
+        coverage[count++] = position & 0xFF;
+
+        remainder += rise;
+        if (remainder >= length && length > 0) {
+            remainder -= length;
+            offset++;
+        }
+    }
+    ILI9341_DrawCoverageRun(ili9341, steep, run_major, run_minor, coverage, count,
+                            ILI9341_AA_RUN_FIRST | ILI9341_AA_RUN_SECOND, color, background);
+}
+
+void ILI9341_DrawLineAA(
+    ILI9341_HandleTypeDef* ili9341,
+    int16_t x1,
+    int16_t y1,
+    int16_t x2,
+    int16_t y2,
+    uint16_t color,
+    uint16_t background
+) {
+    ILI9341_Select(ili9341);
+    ILI9341_DrawLineAAFast(ili9341, x1, y1, x2, y2, color, background);
+    ILI9341_Deselect(ili9341);
+}
+
+/**
+ * @brief Draw the 4 reflections of a run of an anti-aliased circle octant
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param steep true for the octants next to the x axis, the pairs are then on rows
+ * @param major_center Coordinate of the center along the major axis
+ * @param minor_center Coordinate of the center along the minor axis
+ * @param t0 First offset of the run along the major axis
+ * @param coverage Coverage of the outer pixel of the pair at each offset
+ * @param count Number of offsets
+ * @param radius Offset of the inner pixel of the pair along the minor axis
+ * @param inner false to leave the inner pixel out
+ * @param color 16-bit circle color in RGB565 format
+ * @param background Color blended with when no framebuffer is attached
+ * @note Offset 0 is on the axis, the reflections across it are left out.
+ */
+static void ILI9341_DrawCircleAARun(
+    ILI9341_HandleTypeDef* ili9341,
+    bool steep,
+    int32_t major_center,
+    int32_t minor_center,
+    int32_t t0,
+    const uint8_t* coverage,
+    uint8_t count,
+    int32_t radius,
+    bool inner,
+    uint16_t color,
+    uint16_t background
+) {
+    for (uint8_t reflection = 0; reflection < 4; reflection++) {
+        bool major_back = reflection & 1;
+        bool minor_back = reflection & 2;
+
+        const uint8_t* run = coverage;
+        uint8_t run_count = count;
+        if (major_back && t0 == 0) {
+            run++;
+            run_count--;
         }
+        if (run_count == 0) continue;
+
+        // the outer pixel is the second one of the pair on the far side and the first one on the near side
+        uint8_t flags = minor_back ? ILI9341_AA_RUN_INVERT : 0;
+        if (major_back) flags |= ILI9341_AA_RUN_REVERSE;
+        flags |= minor_back ? ILI9341_AA_RUN_FIRST : ILI9341_AA_RUN_SECOND;
+        if (inner) flags |= minor_back ? ILI9341_AA_RUN_SECOND : ILI9341_AA_RUN_FIRST;
+
+        int32_t major = major_back ? major_center - (t0 + count - 1) : major_center + t0;
+        int32_t minor = minor_back ? minor_center - radius - 1 : minor_center + radius;
+        ILI9341_DrawCoverageRun(ili9341, steep, major, minor, run, run_count, flags, color, background);
+    }
+}
+
+void ILI9341_DrawCircleAA(
+    ILI9341_HandleTypeDef* ili9341,
+    int16_t xc,
+    int16_t yc,
+    uint16_t r,
+    uint16_t color,
+    uint16_t background
+) {
+    if (!ILI9341_ClipBox(ili9341, xc - r - 1, yc - r - 1, 2 * r + 3, 2 * r + 3, NULL)) return;
+    if (r == 0) {
+        ILI9341_DrawPixel(ili9341, xc, yc, color);
+        return;
     }
 
+    // offsets up to last have their pairs on columns, further on the octant is drawn from the other axis with pairs
+    // on rows, the only pixel both would draw is (last, last), it is left to the columns
+    int32_t last = ILI9341_SquareRoot((uint32_t)r * r / 2);
+
+    ILI9341_Select(ili9341);
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        bool steep = pass == 1;
+        int32_t major_center = steep ? yc : xc;
+        int32_t minor_center = steep ? xc : yc;
+        uint8_t coverage[ILI9341_AA_RUN_STEPS];
+        uint8_t count = 0;
+        int32_t run_t0 = 0;
+        int32_t run_radius = 0;
+
+        for (int32_t t = 0; t <= last; t++) {
+            // distance of the circle to the axis in 1/256 of a pixel, the pair is the pixel inside it and the next one
+            int32_t position = ILI9341_SquareRoot(((uint64_t)r * r - (uint64_t)t * t) << 16);
+            int32_t radius = position >> 8;
+            if (count > 0 && (radius != run_radius || count == ILI9341_AA_RUN_STEPS || (steep && t == last))) {
+                ILI9341_DrawCircleAARun(ili9341, steep, major_center, minor_center, run_t0, coverage, count,
+                                        run_radius, true, color, background);
+                count = 0;
+            }
+            if (count == 0) {
+                run_t0 = t;
+                run_radius = radius;
+            }
+            coverage[count++] = position & 0xFF;
+        }
+        bool inner = !steep || run_t0 < last || run_radius > last;
+        ILI9341_DrawCircleAARun(ili9341, steep, major_center, minor_center, run_t0, coverage, count, run_radius,
+                                inner, color, background);
+    }
     ILI9341_Deselect(ili9341);
 }
 
+void ILI9341_DrawPolygonAA(
+    ILI9341_HandleTypeDef* ili9341,
+    const int16_t* x,
+    const int16_t* y,
+    uint16_t n,
+    uint16_t color,
+    uint16_t background
+) {
+    if (n < 2) return;
+
+    ILI9341_Select(ili9341);
+    for (uint16_t i = 0; i < n; i++) {
+        uint16_t k = i + 1 < n ? i + 1 : 0;
+        if (n == 2 && k == 0) break;
+        ILI9341_DrawLineAAFast(ili9341, x[i], y[i], x[k], y[k], color, background);
+    }
+    ILI9341_Deselect(ili9341);
+}
 
 void ILI9341_DefineVerticalScrollArea(ILI9341_HandleTypeDef* ili9341, uint16_t topFixedLines, uint16_t bottomFixedLines) {
     uint16_t verticalScrollingArea = 320 - topFixedLines - bottomFixedLines;
@@ -0,0 +1,254 @@
+/* vim: set ai et ts=4 sw=4: */
+#include "ili9341_fmc.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Write to a bus address with an access as wide as the bus
+ * @param bus Pointer to the bus of the display
+ * @param reg Command or data address of the bus
+ * @param value Value to write, a byte on an 8-bit bus
+ * @note A halfword store to an 8-bit wide bank would be split into two byte cycles, so an 8-bit bus gets byte stores.
+ */
+static inline void ILI9341_FMC_Write(const ILI9341_FMC_BusTypeDef* bus, volatile uint16_t* reg, uint16_t value) {
+    if (bus->bus_16bit) {
+        ILI9341_FMC_WRITE(reg, value);
+    } else {
+        ILI9341_FMC_WRITE((volatile uint8_t*)reg, (uint8_t)value);
+    }
+}
+
+/**
+ * @brief Write a data word and count it
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param bus Pointer to the bus of the display
+ * @param value Data word, bytes on an 8-bit bus
+ */
+static inline void ILI9341_FMC_WriteWord(ILI9341_HandleTypeDef* ili9341, ILI9341_FMC_BusTypeDef* bus, uint16_t value) {
+    ILI9341_FMC_Write(bus, bus->data, value);
+    ili9341->stats.transfers++;
+}
+
+/**
+ * @brief Chip select is driven by the memory controller, nothing to do
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_FMC_Select(ILI9341_HandleTypeDef* ili9341) {
+    (void)ili9341;
+}
+
+/**
+ * @brief Chip select is driven by the memory controller, nothing to do
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_FMC_Deselect(ILI9341_HandleTypeDef* ili9341) {
+    (void)ili9341;
+}
+
+/**
+ * @brief Pulse the reset pin if there is one
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_FMC_Reset(ILI9341_HandleTypeDef* ili9341) {
+    #ifndef ILI9341_HOST_BUILD
+    ILI9341_FMC_BusTypeDef* bus = ili9341->transport_ctx;
+    if (bus->rst_port) {
+        HAL_GPIO_WritePin(bus->rst_port, bus->rst_pin, GPIO_PIN_RESET);
+        HAL_Delay(5);
+        HAL_GPIO_WritePin(bus->rst_port, bus->rst_pin, GPIO_PIN_SET);
+    }
+    #else
+    (void)ili9341;
+    #endif
+}
+
+/**
+ * @brief Wait for the given number of milliseconds, host builds don't wait
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param ms Number of milliseconds to wait
+ */
+static void ILI9341_FMC_Delay(ILI9341_HandleTypeDef* ili9341, uint32_t ms) {
+    (void)ili9341;
+    #ifndef ILI9341_HOST_BUILD
+    HAL_Delay(ms);
+    #else
+    (void)ms;
+    #endif
+}
+
+/**
+ * @brief Write a command byte to the command address
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param cmd Command byte to write
+ */
+static void ILI9341_FMC_WriteCommand(ILI9341_HandleTypeDef* ili9341, uint8_t cmd) {
+    ILI9341_FMC_BusTypeDef* bus = ili9341->transport_ctx;
+    bus->memory_write = cmd == 0x2C /* RAMWR */ || cmd == 0x3C /* RAMWRC */;
+    bus->memory_read = cmd == 0x2E /* RAMRD */ || cmd == 0x3E /* RAMRDC */;
+    bus->dummy_read = bus->memory_read;
+    bus->pending_byte = -1;
+
+    ILI9341_FMC_Write(bus, bus->command, cmd);
+    ili9341->stats.transfers++;
+    ili9341->stats.bytes++;
+}
+
+/**
+ * @brief Write data bytes to the data address
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param buff Pointer to the data buffer
+ * @param buff_size Size of the data buffer
+ * @note Parameters are always sent one byte per write. Pixel bytes of a memory write on a 16-bit bus are paired into
+ * one write per pixel, most significant byte first, also across calls.
+ */
+static void ILI9341_FMC_WriteData(ILI9341_HandleTypeDef* ili9341, const uint8_t* buff, size_t buff_size) {
+    ILI9341_FMC_BusTypeDef* bus = ili9341->transport_ctx;
+    ili9341->stats.bytes += buff_size;
+
+    if (!bus->memory_write || !bus->bus_16bit) {
+        for (size_t i = 0; i < buff_size; i++) { ILI9341_FMC_WriteWord(ili9341, bus, buff[i]); }
+        return;
+    }
+
+    for (size_t i = 0; i < buff_size; i++) {
+        if (bus->pending_byte < 0) {
+            bus->pending_byte = buff[i];
+        } else {
+            ILI9341_FMC_WriteWord(ili9341, bus, (uint16_t)bus->pending_byte << 8 | buff[i]);
+            bus->pending_byte = -1;
+        }
+    }
+}
+
+/**
+ * @brief Write native order pixels to the data address
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param pixels Pointer to the pixels in RGB565 format
+ * @param count Number of pixels
+ */
+static void ILI9341_FMC_WritePixelData(ILI9341_HandleTypeDef* ili9341, const uint16_t* pixels, size_t count) {
+    ILI9341_FMC_BusTypeDef* bus = ili9341->transport_ctx;
+    ili9341->stats.bytes += count * 2;
+
+    if (bus->bus_16bit) {
+        for (size_t i = 0; i < count; i++) { ILI9341_FMC_WriteWord(ili9341, bus, pixels[i]); }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            ILI9341_FMC_WriteWord(ili9341, bus, pixels[i] >> 8);
+            ILI9341_FMC_WriteWord(ili9341, bus, pixels[i] & 0xFF);
+        }
+    }
+}
+
+/**
+ * @brief Write native order pixels to the data address, the CPU does the writes so transfers complete immediately
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param pixels Pointer to the pixels in RGB565 format
+ * @param count Number of pixels
+ */
+static void ILI9341_FMC_WritePixelDataAsync(ILI9341_HandleTypeDef* ili9341, const uint16_t* pixels, size_t count) {
+    ILI9341_FMC_WritePixelData(ili9341, pixels, count);
+    if (ili9341->transfer_callback) ili9341->transfer_callback(ili9341, ili9341->transfer_callback_arg);
+}
+
+/**
+ * @brief Transfers complete before the write calls return, nothing to wait for
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_FMC_Wait(ILI9341_HandleTypeDef* ili9341) {
+    (void)ili9341;
+}
+
+/**
+ * @brief Write the same pixel color multiple times to the data address
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param color 16-bit pixel color in RGB565 format
+ * @param count Number of pixels to write
+ */
+static void ILI9341_FMC_WritePixels(ILI9341_HandleTypeDef* ili9341, uint16_t color, uint32_t count) {
+    ILI9341_FMC_BusTypeDef* bus = ili9341->transport_ctx;
+    ili9341->stats.bytes += count * 2;
+
+    if (bus->bus_16bit) {
+        volatile uint16_t* data = bus->data;
+        ili9341->stats.transfers += count;
+        for (uint32_t i = 0; i < count; i++) { ILI9341_FMC_WRITE(data, color); }
+    } else {
+        volatile uint8_t* data = (volatile uint8_t*)bus->data;
+        ili9341->stats.transfers += count * 2;
+        for (uint32_t i = 0; i < count; i++) {
+            ILI9341_FMC_WRITE(data, color >> 8);
+            ILI9341_FMC_WRITE(data, color & 0xFF);
+        }
+    }
+}
+
+/**
+ * @brief Read data bytes from the data address
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param buff Pointer to the receive buffer
+ * @param buff_size Number of bytes to read
+ * @note Each read cycle is a byte, except for memory reads on a 16-bit bus: the dummy cycle is the dummy byte and the
+ * following cycles are 2 color components, upper byte first, the second one is kept for the next byte read.
+ */
+static void ILI9341_FMC_ReadData(ILI9341_HandleTypeDef* ili9341, uint8_t* buff, size_t buff_size) {
+    ILI9341_FMC_BusTypeDef* bus = ili9341->transport_ctx;
+    if (!bus->bus_16bit) {
+        volatile uint8_t* data = (volatile uint8_t*)bus->data;
+        for (size_t i = 0; i < buff_size; i++) { buff[i] = ILI9341_FMC_READ(data); }
+        ili9341->stats.transfers += buff_size;
+        return;
+    }
+
+    for (size_t i = 0; i < buff_size; i++) {
+        if (bus->pending_byte >= 0) {
+            buff[i] = bus->pending_byte;
+            bus->pending_byte = -1;
+            continue;
+        }
+
+        uint16_t value = ILI9341_FMC_READ(bus->data);
+        ili9341->stats.transfers++;
+        if (bus->memory_read && !bus->dummy_read) {
+            buff[i] = value >> 8;
+            bus->pending_byte = value & 0xFF;
+        } else {
+            buff[i] = value & 0xFF;
+            bus->dummy_read = false;
+        }
+    }
+}
+
+static const ILI9341_TransportTypeDef ILI9341_FMC_Transport = {
+    .select = ILI9341_FMC_Select,
+    .deselect = ILI9341_FMC_Deselect,
+    .reset = ILI9341_FMC_Reset,
+    .delay = ILI9341_FMC_Delay,
+    .write_command = ILI9341_FMC_WriteCommand,
+    .write_data = ILI9341_FMC_WriteData,
+    .write_pixel_data = ILI9341_FMC_WritePixelData,
+    .write_pixel_data_async = ILI9341_FMC_WritePixelDataAsync,
+    .wait = ILI9341_FMC_Wait,
+    .write_pixels = ILI9341_FMC_WritePixels,
+    .read_data = ILI9341_FMC_ReadData
+};
+
+ILI9341_HandleTypeDef ILI9341_FMC_Init(ILI9341_FMC_BusTypeDef* bus, uint8_t rotation, uint16_t width, uint16_t height) {
+    bus->memory_write = false;
+    bus->memory_read = false;
+    bus->dummy_read = false;
+    bus->pending_byte = -1;
+
+    ILI9341_HandleTypeDef ili9341_instance = {
+        .transport = &ILI9341_FMC_Transport,
+        .transport_ctx = bus,
+        .rotation = rotation,
+        .width = width,
+        .height = height
+    };
+
+    ILI9341_InitDisplay(&ili9341_instance);
+
+    return ili9341_instance;
+}
@@ -0,0 +1,528 @@
+/* vim: set ai et ts=4 sw=4: */
+#include "ili9341.h"
+
+#ifndef ILI9341_HOST_BUILD
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stm32f7xx_hal.h"
+#include "stm32f7xx_hal_spi.h"
+
+// SPI frame configurations of a bus
+#define ILI9341_HAL_FRAMES_BYTES 0   // 8-bit frames, commands, parameters and reads
+#define ILI9341_HAL_FRAMES_PIXELS 1  // 16-bit frames from an incremented source, pixel data
+#define ILI9341_HAL_FRAMES_FILL 2    // 16-bit frames from a fixed source address, fills with DMA
+
+// line size of the Cortex-M7 data cache, DMA sources are cleaned in whole lines
+#define ILI9341_HAL_CACHE_LINE 32U
+
+static ILI9341_BusTypeDef ili9341_buses[ILI9341_MAX_SPI_BUSES];
+
+/**
+ * @brief Find the transfer state of an SPI bus, allocating it on first use
+ * @param spi_handle Pointer to the SPI handle
+ * @return Pointer to the bus state, NULL if all ILI9341_MAX_SPI_BUSES slots are taken
+ */
+static ILI9341_BusTypeDef* ILI9341_HAL_GetBus(SPI_HandleTypeDef* spi_handle) {
+    for (uint8_t i = 0; i < ILI9341_MAX_SPI_BUSES; i++) {
+        if (ili9341_buses[i].spi_handle && ili9341_buses[i].spi_handle->Instance == spi_handle->Instance) {
+            return &ili9341_buses[i];
+        }
+    }
+
+    for (uint8_t i = 0; i < ILI9341_MAX_SPI_BUSES; i++) {
+        if (!ili9341_buses[i].spi_handle) {
+            ili9341_buses[i].spi_handle = spi_handle;
+            return &ili9341_buses[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Drive the chip select pin
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param state GPIO_PIN_RESET to select the display, GPIO_PIN_SET to release it
+ */
+static inline void ILI9341_HAL_WriteCS(ILI9341_HandleTypeDef* ili9341, GPIO_PinState state) {
+    #ifdef ILI9341_FAST_IO
+    *ili9341->cs_bsrr = state == GPIO_PIN_SET ? ili9341->cs_pin : (uint32_t)ili9341->cs_pin << 16;
+    #else
+    HAL_GPIO_WritePin(ili9341->cs_port, ili9341->cs_pin, state);
+    #endif
+}
+
+/**
+ * @brief Drive the data/command pin
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param state GPIO_PIN_RESET for commands, GPIO_PIN_SET for data
+ */
+static inline void ILI9341_HAL_WriteDC(ILI9341_HandleTypeDef* ili9341, GPIO_PinState state) {
+    #ifdef ILI9341_FAST_IO
+    *ili9341->dc_bsrr = state == GPIO_PIN_SET ? ili9341->dc_pin : (uint32_t)ili9341->dc_pin << 16;
+    #else
+    HAL_GPIO_WritePin(ili9341->dc_port, ili9341->dc_pin, state);
+    #endif
+}
+
+#ifdef ILI9341_FAST_IO
+/**
+ * @brief Send bytes by writing the SPI data register directly, returns when the last byte has left the bus
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param buff Pointer to the data buffer
+ * @param size Number of bytes to send
+ * @note The bus must be idle and configured for 8-bit frames.
+ */
+static void ILI9341_HAL_FastTransmit(ILI9341_HandleTypeDef* ili9341, const uint8_t* buff, size_t size) {
+    SPI_TypeDef* spi = ili9341->spi_handle->Instance;
+    if (!(spi->CR1 & SPI_CR1_SPE)) spi->CR1 |= SPI_CR1_SPE;
+
+    for (size_t i = 0; i < size; i++) {
+        while (!(spi->SR & SPI_SR_TXE)) {}
+        // byte access, a 16-bit write would pack 2 frames into the FIFO
+        *(volatile uint8_t*)&spi->DR = buff[i];
+    }
+
+    // DC and CS must not change before the last byte has been shifted out
+    while (spi->SR & SPI_SR_FTLVL) {}
+    while (spi->SR & SPI_SR_BSY) {}
+
+    // the bus is full duplex, drop the bytes received meanwhile, reading DR then SR also clears the overrun flag
+    while (spi->SR & SPI_SR_FRLVL) { (void)*(volatile uint8_t*)&spi->DR; }
+    (void)spi->SR;
+}
+#endif
+
+/**
+ * @brief Wait until the DMA transfer in flight on the display's bus, if any, has completed
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_HAL_Wait(ILI9341_HandleTypeDef* ili9341) {
+    if (ili9341->bus) {
+        while (ili9341->bus->busy) {}
+    }
+}
+
+/**
+ * @brief Switch the SPI frame configuration of the display's bus
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param frames One of ILI9341_HAL_FRAMES_* values
+ * @note The bus must be idle. The frame size is changed in the SPI registers and the TX DMA stream is given the
+ * matching source width, which HAL keeps across transfers. ILI9341_HAL_FRAMES_BYTES restores 8-bit frames from an
+ * incremented byte source, the configuration the driver expects from the SPI and DMA initialization code.
+ */
+static void ILI9341_HAL_SetFrames(ILI9341_HandleTypeDef* ili9341, uint8_t frames) {
+    ILI9341_BusTypeDef* bus = ili9341->bus;
+    if (!bus || bus->frames == frames) return;
+
+    SPI_HandleTypeDef* spi_handle = ili9341->spi_handle;
+    bool wide = frames != ILI9341_HAL_FRAMES_BYTES;
+    spi_handle->Init.DataSize = wide ? SPI_DATASIZE_16BIT : SPI_DATASIZE_8BIT;
+
+    // the frame size can only be changed while the peripheral is disabled, HAL enables it again on the next transfer
+    __HAL_SPI_DISABLE(spi_handle);
+    MODIFY_REG(spi_handle->Instance->CR2, SPI_CR2_DS, spi_handle->Init.DataSize);
+
+    #ifdef ILI9341_ENABLE_DMA
+    DMA_HandleTypeDef* dma_handle = spi_handle->hdmatx;
+    if (dma_handle) {
+        dma_handle->Init.MemInc = frames == ILI9341_HAL_FRAMES_FILL ? DMA_MINC_DISABLE : DMA_MINC_ENABLE;
+        dma_handle->Init.PeriphDataAlignment = wide ? DMA_PDATAALIGN_HALFWORD : DMA_PDATAALIGN_BYTE;
+        dma_handle->Init.MemDataAlignment = wide ? DMA_MDATAALIGN_HALFWORD : DMA_MDATAALIGN_BYTE;
+        MODIFY_REG(
+            dma_handle->Instance->CR,
+            DMA_SxCR_MINC | DMA_SxCR_PSIZE | DMA_SxCR_MSIZE,
+            dma_handle->Init.MemInc | dma_handle->Init.PeriphDataAlignment | dma_handle->Init.MemDataAlignment
+        );
+    }
+    #endif
+
+    bus->frames = frames;
+}
+
+/**
+ * @brief Wait for the transfer in flight on the display's bus and set up the bus for the next one
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param frames One of ILI9341_HAL_FRAMES_* values
+ */
+static void ILI9341_HAL_Prepare(ILI9341_HandleTypeDef* ili9341, uint8_t frames) {
+    ILI9341_HAL_Wait(ili9341);
+    ILI9341_HAL_SetFrames(ili9341, frames);
+}
+
+#ifdef ILI9341_ENABLE_DMA
+/**
+ * @brief Start a DMA transfer on the display's bus
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param buff Pointer to the source, must stay valid until the transfer completes
+ * @param size Number of SPI frames to send
+ * @param notify true to run the transfer callback when the transfer completes
+ */
+static void ILI9341_HAL_StartDMA(ILI9341_HandleTypeDef* ili9341, const uint8_t* buff, uint16_t size, bool notify) {
+    ILI9341_BusTypeDef* bus = ili9341->bus;
+
+    #if defined(__DCACHE_PRESENT) && __DCACHE_PRESENT
+    // the CPU has just written the source, write it back from the data cache for the DMA to read it from memory
+    if (SCB->CCR & SCB_CCR_DC_Msk) {
+        uint32_t bytes = bus->frames == ILI9341_HAL_FRAMES_BYTES ? size : (uint32_t)size * 2;
+        // a fill streams a single word, rewritten by the CPU before every fill
+        if (bus->frames == ILI9341_HAL_FRAMES_FILL) bytes = sizeof(bus->fill_color);
+        uintptr_t start = (uintptr_t)buff & ~(uintptr_t)(ILI9341_HAL_CACHE_LINE - 1);
+        SCB_CleanDCache_by_Addr((uint32_t*)start, (int32_t)((uintptr_t)buff + bytes - start));
+    }
+    #endif
+
+    bus->owner = ili9341;
+    bus->notify = notify;
+    bus->busy = true;
+    ili9341->stats.transfers++;
+    HAL_SPI_Transmit_DMA(ili9341->spi_handle, (uint8_t*)buff, size);
+}
+#endif
+
+/**
+ * @brief Send SPI frames in the bus's current frame configuration, with DMA when enabled
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param buff Pointer to the data buffer
+ * @param size Number of frames to send
+ * @param wait true to return after the transfer has completed, false to return while it is in flight
+ * @return true if the transfer was started with DMA, false if it was sent in blocking mode
+ */
+static bool ILI9341_HAL_Transmit(ILI9341_HandleTypeDef* ili9341, const uint8_t* buff, uint16_t size, bool wait) {
+    #ifdef ILI9341_ENABLE_DMA
+    if (ili9341->bus) {
+        ILI9341_HAL_Wait(ili9341);
+        ILI9341_HAL_StartDMA(ili9341, buff, size, !wait);
+        if (wait) ILI9341_HAL_Wait(ili9341);
+        return true;
+    }
+    #endif
+
+    (void)wait;
+    ili9341->stats.transfers++;
+    HAL_SPI_Transmit(ili9341->spi_handle, (uint8_t*)buff, size, HAL_MAX_DELAY);
+    return false;
+}
+
+/**
+ * @brief Assert the chip select pin, after the transfer of another display on the same bus has completed
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_HAL_Select(ILI9341_HandleTypeDef* ili9341) {
+    ILI9341_BusTypeDef* bus = ili9341->bus;
+    if (bus) {
+        if (bus->owner != ili9341) ILI9341_HAL_Wait(ili9341);
+
+        // a deselect deferred to the end of the transfer in flight is cancelled, chip select simply stays asserted
+        bus->deselect_pending = false;
+    }
+    ILI9341_HAL_WriteCS(ili9341, GPIO_PIN_RESET);
+}
+
+/**
+ * @brief Release the chip select pin, deferred to the completion interrupt while a DMA transfer is in flight
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_HAL_Deselect(ILI9341_HandleTypeDef* ili9341) {
+    ILI9341_BusTypeDef* bus = ili9341->bus;
+    if (bus && bus->owner == ili9341) {
+        bus->deselect_pending = true;
+        if (bus->busy) return;
+        bus->deselect_pending = false;
+    }
+    ILI9341_HAL_WriteCS(ili9341, GPIO_PIN_SET);
+}
+
+/**
+ * @brief Pulse the reset pin
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_HAL_Reset(ILI9341_HandleTypeDef* ili9341) {
+    HAL_GPIO_WritePin(ili9341->rst_port, ili9341->rst_pin, GPIO_PIN_RESET);
+    HAL_Delay(5);
+    HAL_GPIO_WritePin(ili9341->rst_port, ili9341->rst_pin, GPIO_PIN_SET);
+}
+
+/**
+ * @brief Wait for the given number of milliseconds
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param ms Number of milliseconds to wait
+ */
+static void ILI9341_HAL_Delay(ILI9341_HandleTypeDef* ili9341, uint32_t ms) {
+    (void)ili9341;
+    HAL_Delay(ms);
+}
+
+/**
+ * @brief Write a command byte over SPI
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param cmd Command byte to write
+ */
+static void ILI9341_HAL_WriteCommand(ILI9341_HandleTypeDef* ili9341, uint8_t cmd) {
+    ILI9341_HAL_Prepare(ili9341, ILI9341_HAL_FRAMES_BYTES);
+    ILI9341_HAL_WriteDC(ili9341, GPIO_PIN_RESET);
+    ili9341->stats.transfers++;
+    ili9341->stats.bytes++;
+    #ifdef ILI9341_FAST_IO
+    ILI9341_HAL_FastTransmit(ili9341, &cmd, sizeof(cmd));
+    #else
+    HAL_SPI_Transmit(ili9341->spi_handle, &cmd, sizeof(cmd), HAL_MAX_DELAY);
+    #endif
+}
+
+/**
+ * @brief Send data over SPI with DC high
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param frames ILI9341_HAL_FRAMES_BYTES for bytes, ILI9341_HAL_FRAMES_PIXELS for native order 16-bit pixels
+ * @param buff Pointer to the data, must stay untouched until the transfer completes when wait is false
+ * @param count Number of bytes or pixels
+ * @param wait true to return after the transfer has completed, false to return while the last chunk is in flight
+ */
+static void ILI9341_HAL_Send(
+    ILI9341_HandleTypeDef* ili9341,
+    uint8_t frames,
+    const uint8_t* buff,
+    size_t count,
+    bool wait
+) {
+    size_t frame_size = frames == ILI9341_HAL_FRAMES_BYTES ? 1 : 2;
+
+    ILI9341_HAL_Prepare(ili9341, frames);
+    ILI9341_HAL_WriteDC(ili9341, GPIO_PIN_SET);
+    ili9341->stats.bytes += count * frame_size;
+
+    #ifdef ILI9341_FAST_IO
+    // parameter blocks are too short to be worth a HAL call or a DMA transfer, they are always sent with wait set
+    if (frames == ILI9341_HAL_FRAMES_BYTES && count <= ILI9341_FAST_IO_MAX_BYTES) {
+        ili9341->stats.transfers++;
+        ILI9341_HAL_FastTransmit(ili9341, buff, count);
+        return;
+    }
+    #endif
+
+    // split data in small chunks because HAL can't send more then 64K frames at once
+    bool dma = false;
+    while (count > 0) {
+        uint16_t chunk_size = count > 32768 ? 32768 : count;
+        dma = ILI9341_HAL_Transmit(ili9341, buff, chunk_size, wait);
+        buff += chunk_size * frame_size;
+        count -= chunk_size;
+    }
+
+    if (!wait && !dma && ili9341->transfer_callback) {
+        ili9341->transfer_callback(ili9341, ili9341->transfer_callback_arg);
+    }
+}
+
+/**
+ * @brief Write data bytes over SPI
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param buff Pointer to the data buffer
+ * @param buff_size Size of the data buffer
+ */
+static void ILI9341_HAL_WriteData(ILI9341_HandleTypeDef* ili9341, const uint8_t* buff, size_t buff_size) {
+    ILI9341_HAL_Send(ili9341, ILI9341_HAL_FRAMES_BYTES, buff, buff_size, true);
+}
+
+/**
+ * @brief Write native order pixels over SPI as 16-bit frames
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param pixels Pointer to the pixels in RGB565 format
+ * @param count Number of pixels
+ */
+static void ILI9341_HAL_WritePixelData(ILI9341_HandleTypeDef* ili9341, const uint16_t* pixels, size_t count) {
+    ILI9341_HAL_Send(ili9341, ILI9341_HAL_FRAMES_PIXELS, (const uint8_t*)pixels, count, true);
+}
+
+/**
+ * @brief Start sending native order pixels over SPI as 16-bit frames, returns while the last chunk is still in flight
+ * when DMA is enabled
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param pixels Pointer to the pixels in RGB565 format, must stay untouched until the transfer completes
+ * @param count Number of pixels
+ */
+static void ILI9341_HAL_WritePixelDataAsync(ILI9341_HandleTypeDef* ili9341, const uint16_t* pixels, size_t count) {
+    ILI9341_HAL_Send(ili9341, ILI9341_HAL_FRAMES_PIXELS, (const uint8_t*)pixels, count, false);
+}
+
+/**
+ * @brief Write the same pixel color multiple times over SPI
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param color 16-bit pixel color in RGB565 format
+ * @param count Number of pixels to write
+ * @note With DMA the color is streamed as 16-bit frames from a single word with the memory address held fixed, up to
+ * 65535 pixels per transfer, and the function returns while the last transfer is in flight. Without DMA a buffer of
+ * ILI9341_FILL_RECT_BUFFER_SIZE pixels is sent repeatedly as 16-bit frames.
+ */
+static void ILI9341_HAL_WritePixels(ILI9341_HandleTypeDef* ili9341, uint16_t color, uint32_t count) {
+    #ifdef ILI9341_ENABLE_DMA
+    ILI9341_BusTypeDef* bus = ili9341->bus;
+    if (bus) {
+        ILI9341_HAL_Prepare(ili9341, ILI9341_HAL_FRAMES_FILL);
+        ILI9341_HAL_WriteDC(ili9341, GPIO_PIN_SET);
+
+        // 16-bit frames are shifted out most significant byte first, the color needs no byte swap, the word is cleaned
+        // from the data cache by ILI9341_HAL_StartDMA
+        bus->fill_color = color;
+        ili9341->stats.bytes += count * 2;
+        while (count > 0) {
+            uint16_t chunk_size = count > 0xFFFF ? 0xFFFF : count;
+            ILI9341_HAL_Wait(ili9341);
+            ILI9341_HAL_StartDMA(ili9341, (const uint8_t*)&bus->fill_color, chunk_size, true);
+            count -= chunk_size;
+        }
+        return;
+    }
+    #endif
+
+    uint16_t buffer[ILI9341_FILL_RECT_BUFFER_SIZE];
+    for (uint32_t i = 0; i < ILI9341_FILL_RECT_BUFFER_SIZE; i++) { buffer[i] = color; }
+
+    while (count > 0) {
+        uint16_t chunk_size = (count > ILI9341_FILL_RECT_BUFFER_SIZE) ? ILI9341_FILL_RECT_BUFFER_SIZE : count;
+        ILI9341_HAL_WritePixelData(ili9341, buffer, chunk_size);
+        count -= chunk_size;
+    }
+}
+
+/**
+ * @brief Get the clock the SPI peripheral divides its bit rate from
+ * @param spi Pointer to the SPI peripheral
+ * @return Clock of the APB bus the peripheral is on in Hz
+ */
+static uint32_t ILI9341_HAL_KernelClock(SPI_TypeDef* spi) {
+    // SPI2 and SPI3 are on APB1, the others on APB2
+    #ifdef SPI2
+    if (spi == SPI2) return HAL_RCC_GetPCLK1Freq();
+    #endif
+    #ifdef SPI3
+    if (spi == SPI3) return HAL_RCC_GetPCLK1Freq();
+    #endif
+    (void)spi;
+    return HAL_RCC_GetPCLK2Freq();
+}
+
+/**
+ * @brief Read data bytes over SPI
+ * @param ili9341 Pointer to ILI9341 handle structure
+ * @param buff Pointer to the receive buffer
+ * @param buff_size Number of bytes to read
+ * @note The panel's read cycle is much longer than its write cycle, the baud rate prescaler is raised for the read
+ * until the bit rate is at most ILI9341_READ_SPI_MAX_HZ, and restored afterwards.
+ */
+static void ILI9341_HAL_ReadData(ILI9341_HandleTypeDef* ili9341, uint8_t* buff, size_t buff_size) {
+    ILI9341_HAL_Prepare(ili9341, ILI9341_HAL_FRAMES_BYTES);
+    ILI9341_HAL_WriteDC(ili9341, GPIO_PIN_SET);
+
+    SPI_TypeDef* spi = ili9341->spi_handle->Instance;
+    uint32_t write_rate = READ_BIT(spi->CR1, SPI_CR1_BR);
+    uint32_t clock = ILI9341_HAL_KernelClock(spi);
+    uint32_t read_rate = write_rate >> SPI_CR1_BR_Pos;
+    // the bit rate is the kernel clock divided by 2 << BR
+    while (read_rate < 7 && (clock >> (read_rate + 1)) > ILI9341_READ_SPI_MAX_HZ) read_rate++;
+    read_rate <<= SPI_CR1_BR_Pos;
+
+    // the prescaler can only be changed while the peripheral is disabled, HAL enables it again on the next transfer
+    if (read_rate != write_rate) {
+        __HAL_SPI_DISABLE(ili9341->spi_handle);
+        MODIFY_REG(spi->CR1, SPI_CR1_BR, read_rate);
+    }
+
+    while (buff_size > 0) {
+        uint16_t chunk_size = buff_size > 32768 ? 32768 : buff_size;
+        ili9341->stats.transfers++;
+        HAL_SPI_Receive(ili9341->spi_handle, buff, chunk_size, HAL_MAX_DELAY);
+        buff += chunk_size;
+        buff_size -= chunk_size;
+    }
+
+    if (read_rate != write_rate) {
+        __HAL_SPI_DISABLE(ili9341->spi_handle);
+        MODIFY_REG(spi->CR1, SPI_CR1_BR, write_rate);
+    }
+}
+
+static const ILI9341_TransportTypeDef ILI9341_HAL_Transport = {
+    .select = ILI9341_HAL_Select,
+    .deselect = ILI9341_HAL_Deselect,
+    .reset = ILI9341_HAL_Reset,
+    .delay = ILI9341_HAL_Delay,
+    .write_command = ILI9341_HAL_WriteCommand,
+    .write_data = ILI9341_HAL_WriteData,
+    .write_pixel_data = ILI9341_HAL_WritePixelData,
+    .write_pixel_data_async = ILI9341_HAL_WritePixelDataAsync,
+    .wait = ILI9341_HAL_Wait,
+    .write_pixels = ILI9341_HAL_WritePixels,
+    .read_data = ILI9341_HAL_ReadData
+};
+
+bool ILI9341_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi) {
+    #ifdef ILI9341_ENABLE_DMA
+    for (uint8_t i = 0; i < ILI9341_MAX_SPI_BUSES; i++) {
+        ILI9341_BusTypeDef* bus = &ili9341_buses[i];
+        if (!bus->spi_handle || bus->spi_handle->Instance != hspi->Instance) continue;
+
+        ILI9341_HandleTypeDef* ili9341 = bus->owner;
+        bus->busy = false;
+        if (!ili9341) return true;
+
+        if (bus->deselect_pending) {
+            bus->deselect_pending = false;
+            ILI9341_HAL_WriteCS(ili9341, GPIO_PIN_SET);
+        }
+        if (bus->notify && ili9341->transfer_callback) {
+            ili9341->transfer_callback(ili9341, ili9341->transfer_callback_arg);
+        }
+        return true;
+    }
+    #endif
+
+    (void)hspi;
+    return false;
+}
+
+ILI9341_HandleTypeDef ILI9341_Init(
+    SPI_HandleTypeDef* spi_handle,
+    GPIO_TypeDef* cs_port,
+    uint16_t cs_pin,
+    GPIO_TypeDef* dc_port,
+    uint16_t dc_pin,
+    GPIO_TypeDef* rst_port,
+    uint16_t rst_pin,
+    uint8_t rotation,
+    uint16_t width,
+    uint16_t height
+) {
+    ILI9341_HandleTypeDef ili9341_instance = {
+        .transport = &ILI9341_HAL_Transport,
+        .transport_ctx = NULL,
+        .spi_handle = spi_handle,
+        .cs_port = cs_port,
+        .cs_pin = cs_pin,
+        .dc_port = dc_port,
+        .dc_pin = dc_pin,
+        .rst_port = rst_port,
+        .rst_pin = rst_pin,
+        .cs_bsrr = &cs_port->BSRR,
+        .dc_bsrr = &dc_port->BSRR,
+        .rotation = rotation,
+        .width = width,
+        .height = height
+    };
+
+    ili9341_instance.bus = ILI9341_HAL_GetBus(spi_handle);
+
+    ILI9341_InitDisplay(&ili9341_instance);
+
+    // the handle is returned by copy, the bus must not keep pointing at this one once its last transfer completed
+    if (ili9341_instance.bus) {
+        ILI9341_HAL_Wait(&ili9341_instance);
+        ili9341_instance.bus->owner = NULL;
+    }
+
+    return ili9341_instance;
+}
+
+#endif  // ILI9341_HOST_BUILD
@@ -0,0 +1,464 @@
+/* vim: set ai et ts=4 sw=4: */
+#include "ili9341_sim.h"
+#include <stdio.h>
+#include <string.h>
+
+#define ILI9341_SIM_CMD_SWRESET 0x01
+#define ILI9341_SIM_CMD_SLPIN 0x10
+#define ILI9341_SIM_CMD_SLPOUT 0x11
+#define ILI9341_SIM_CMD_INVOFF 0x20
+#define ILI9341_SIM_CMD_INVON 0x21
+#define ILI9341_SIM_CMD_DISPOFF 0x28
+#define ILI9341_SIM_CMD_DISPON 0x29
+#define ILI9341_SIM_CMD_CASET 0x2A
+#define ILI9341_SIM_CMD_RASET 0x2B
+#define ILI9341_SIM_CMD_RAMWR 0x2C
+#define ILI9341_SIM_CMD_RAMRD 0x2E
+#define ILI9341_SIM_CMD_VSCRDEF 0x33
+#define ILI9341_SIM_CMD_MADCTL 0x36
+#define ILI9341_SIM_CMD_VSCRSADD 0x37
+#define ILI9341_SIM_CMD_PIXSET 0x3A
+#define ILI9341_SIM_CMD_RAMWRC 0x3C
+#define ILI9341_SIM_CMD_RAMRDC 0x3E
+#define ILI9341_SIM_CMD_RDID4 0xD3
+
+/**
+ * @brief Put the simulated controller into its power-on state, GRAM content is kept
+ * @param panel Pointer to the simulated panel
+ */
+static void ILI9341_Sim_ResetController(ILI9341_Sim_PanelTypeDef* panel) {
+    panel->col_start = 0;
+    panel->col_end = ILI9341_SIM_GRAM_WIDTH - 1;
+    panel->page_start = 0;
+    panel->page_end = ILI9341_SIM_GRAM_HEIGHT - 1;
+    panel->col = 0;
+    panel->page = 0;
+    panel->madctl = 0;
+    panel->pixel_format = 0x66;
+    panel->top_fixed_lines = 0;
+    panel->scroll_lines = ILI9341_SIM_GRAM_HEIGHT;
+    panel->bottom_fixed_lines = 0;
+    panel->scroll_start = 0;
+    panel->inverted = false;
+    panel->display_on = false;
+    panel->sleeping = true;
+    panel->cmd = 0;
+    panel->param_count = 0;
+    panel->pixel_half = false;
+}
+
+/**
+ * @brief Map a logical memory address to a GRAM location using the current MADCTL setting
+ * @param panel Pointer to the simulated panel
+ * @param col Column address
+ * @param page Page address
+ * @return Pointer to the GRAM cell, NULL if the address is outside of the address space
+ */
+static uint16_t* ILI9341_Sim_Cell(ILI9341_Sim_PanelTypeDef* panel, uint16_t col, uint16_t page) {
+    bool exchange = panel->madctl & ILI9341_MADCTL_MV;
+    uint16_t col_max = exchange ? ILI9341_SIM_GRAM_HEIGHT - 1 : ILI9341_SIM_GRAM_WIDTH - 1;
+    uint16_t page_max = exchange ? ILI9341_SIM_GRAM_WIDTH - 1 : ILI9341_SIM_GRAM_HEIGHT - 1;
+
+    if (col > col_max || page > page_max) return NULL;
+
+    if (panel->madctl & ILI9341_MADCTL_MX) col = col_max - col;
+    if (panel->madctl & ILI9341_MADCTL_MY) page = page_max - page;
+
+    return exchange ? &panel->gram[col][page] : &panel->gram[page][col];
+}
+
+/**
+ * @brief Advance the memory pointer within the current address window
+ * @param panel Pointer to the simulated panel
+ */
+static void ILI9341_Sim_Advance(ILI9341_Sim_PanelTypeDef* panel) {
+    if (panel->col < panel->col_end) {
+        panel->col++;
+        return;
+    }
+
+    panel->col = panel->col_start;
+    panel->page = panel->page < panel->page_end ? panel->page + 1 : panel->page_start;
+}
+
+/**
+ * @brief Store a pixel at the memory pointer and advance it
+ * @param panel Pointer to the simulated panel
+ * @param color 16-bit pixel color in RGB565 format
+ */
+static void ILI9341_Sim_StorePixel(ILI9341_Sim_PanelTypeDef* panel, uint16_t color) {
+    uint16_t* cell = ILI9341_Sim_Cell(panel, panel->col, panel->page);
+    if (cell) {
+        *cell = color;
+        panel->stats.pixels++;
+    }
+    ILI9341_Sim_Advance(panel);
+}
+
+/**
+ * @brief Apply a parameter byte of the current command
+ * @param panel Pointer to the simulated panel
+ * @param byte Parameter byte
+ */
+static void ILI9341_Sim_Param(ILI9341_Sim_PanelTypeDef* panel, uint8_t byte) {
+    switch (panel->cmd) {
+        case ILI9341_SIM_CMD_RAMWR:
+        case ILI9341_SIM_CMD_RAMWRC:
+            if (!panel->pixel_half) {
+                panel->pixel_msb = byte;
+                panel->pixel_half = true;
+            } else {
+                ILI9341_Sim_StorePixel(panel, (uint16_t)panel->pixel_msb << 8 | byte);
+                panel->pixel_half = false;
+            }
+            return;
+        default:
+            break;
+    }
+
+    if (panel->param_count < sizeof(panel->params)) panel->params[panel->param_count] = byte;
+    panel->param_count++;
+
+    uint8_t* p = panel->params;
+    switch (panel->cmd) {
+        case ILI9341_SIM_CMD_CASET:
+            if (panel->param_count == 4) {
+                panel->col_start = p[0] << 8 | p[1];
+                panel->col_end = p[2] << 8 | p[3];
+            }
+            break;
+        case ILI9341_SIM_CMD_RASET:
+            if (panel->param_count == 4) {
+                panel->page_start = p[0] << 8 | p[1];
+                panel->page_end = p[2] << 8 | p[3];
+            }
+            break;
+        case ILI9341_SIM_CMD_MADCTL:
+            if (panel->param_count == 1) panel->madctl = p[0];
+            break;
+        case ILI9341_SIM_CMD_PIXSET:
+            if (panel->param_count == 1) panel->pixel_format = p[0];
+            break;
+        case ILI9341_SIM_CMD_VSCRDEF:
+            if (panel->param_count == 6) {
+                panel->top_fixed_lines = p[0] << 8 | p[1];
+                panel->scroll_lines = p[2] << 8 | p[3];
+                panel->bottom_fixed_lines = p[4] << 8 | p[5];
+            }
+            break;
+        case ILI9341_SIM_CMD_VSCRSADD:
+            if (panel->param_count == 2) panel->scroll_start = p[0] << 8 | p[1];
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Start decoding a new command
+ * @param panel Pointer to the simulated panel
+ * @param cmd Command byte
+ */
+static void ILI9341_Sim_Command(ILI9341_Sim_PanelTypeDef* panel, uint8_t cmd) {
+    panel->cmd = cmd;
+    panel->param_count = 0;
+    panel->pixel_half = false;
+    panel->read_dummy = true;
+    panel->read_component = 0;
+
+    switch (cmd) {
+        case ILI9341_SIM_CMD_SWRESET:
+            ILI9341_Sim_ResetController(panel);
+            break;
+        case ILI9341_SIM_CMD_SLPIN:
+            panel->sleeping = true;
+            break;
+        case ILI9341_SIM_CMD_SLPOUT:
+            panel->sleeping = false;
+            break;
+        case ILI9341_SIM_CMD_INVOFF:
+            panel->inverted = false;
+            break;
+        case ILI9341_SIM_CMD_INVON:
+            panel->inverted = true;
+            break;
+        case ILI9341_SIM_CMD_DISPOFF:
+            panel->display_on = false;
+            break;
+        case ILI9341_SIM_CMD_DISPON:
+            panel->display_on = true;
+            break;
+        case ILI9341_SIM_CMD_RAMWR:
+        case ILI9341_SIM_CMD_RAMRD:
+            panel->col = panel->col_start;
+            panel->page = panel->page_start;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Produce the next byte of a read command
+ * @param panel Pointer to the simulated panel
+ * @return Byte driven by the controller
+ */
+static uint8_t ILI9341_Sim_ReadByte(ILI9341_Sim_PanelTypeDef* panel) {
+    if (panel->read_dummy) {
+        panel->read_dummy = false;
+        return 0x00;
+    }
+
+    switch (panel->cmd) {
+        case ILI9341_SIM_CMD_RAMRD:
+        case ILI9341_SIM_CMD_RAMRDC: {
+            // memory is read back as 18-bit pixels, one byte per component with the 6 bits left aligned
+            uint16_t* cell = ILI9341_Sim_Cell(panel, panel->col, panel->page);
+            uint16_t color = cell ? *cell : 0;
+            uint8_t component;
+            if (panel->read_component == 0) {
+                component = ((color >> 11) << 1) | (color >> 15);
+            } else if (panel->read_component == 1) {
+                component = (color >> 5) & 0x3F;
+            } else {
+                component = ((color & 0x1F) << 1) | ((color >> 4) & 0x01);
+            }
+
+            if (++panel->read_component == 3) {
+                panel->read_component = 0;
+                ILI9341_Sim_Advance(panel);
+            }
+            return component << 2;
+        }
+        case ILI9341_SIM_CMD_RDID4: {
+            static const uint8_t id4[] = {0x00, 0x93, 0x41};
+            uint8_t byte = panel->read_component < sizeof(id4) ? id4[panel->read_component] : 0x00;
+            panel->read_component++;
+            return byte;
+        }
+        default:
+            return 0x00;
+    }
+}
+
+/**
+ * @brief Update the counters for a bus access with the given DC level
+ * @param panel Pointer to the simulated panel
+ * @param dc DC level of the access
+ * @param bytes Number of bytes moved over the bus
+ */
+static void ILI9341_Sim_Access(ILI9341_Sim_PanelTypeDef* panel, bool dc, uint32_t bytes) {
+    if (panel->dc != dc) {
+        panel->dc = dc;
+        panel->stats.dc_toggles++;
+    }
+    if (!panel->selected) panel->stats.errors += bytes;
+    panel->stats.transactions++;
+}
+
+/**
+ * @brief Assert chip select of the simulated panel
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_Select(ILI9341_HandleTypeDef* ili9341) {
+    ILI9341_Sim_PanelTypeDef* panel = ili9341->transport_ctx;
+    panel->selected = true;
+    panel->stats.selects++;
+}
+
+/**
+ * @brief Release chip select of the simulated panel
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_Deselect(ILI9341_HandleTypeDef* ili9341) {
+    ILI9341_Sim_PanelTypeDef* panel = ili9341->transport_ctx;
+    panel->selected = false;
+}
+
+/**
+ * @brief Pulse the reset line of the simulated panel
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_Reset(ILI9341_HandleTypeDef* ili9341) {
+    ILI9341_Sim_ResetController(ili9341->transport_ctx);
+}
+
+/**
+ * @brief Delays are not simulated, the call returns immediately
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_Delay(ILI9341_HandleTypeDef* ili9341, uint32_t ms) {
+    (void)ili9341;
+    (void)ms;
+}
+
+/**
+ * @brief Write a command byte to the simulated panel
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_WriteCommand(ILI9341_HandleTypeDef* ili9341, uint8_t cmd) {
+    ILI9341_Sim_PanelTypeDef* panel = ili9341->transport_ctx;
+    ILI9341_Sim_Access(panel, false, 1);
+    panel->stats.commands++;
+    ILI9341_Sim_Command(panel, cmd);
+}
+
+/**
+ * @brief Write data bytes to the simulated panel
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_WriteData(ILI9341_HandleTypeDef* ili9341, const uint8_t* buff, size_t buff_size) {
+    ILI9341_Sim_PanelTypeDef* panel = ili9341->transport_ctx;
+    ILI9341_Sim_Access(panel, true, buff_size);
+    panel->stats.data_bytes += buff_size;
+    for (size_t i = 0; i < buff_size; i++) { ILI9341_Sim_Param(panel, buff[i]); }
+}
+
+/**
+ * @brief Write native order pixels to the simulated panel, most significant byte first
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_WritePixelData(ILI9341_HandleTypeDef* ili9341, const uint16_t* pixels, size_t count) {
+    ILI9341_Sim_PanelTypeDef* panel = ili9341->transport_ctx;
+    ILI9341_Sim_Access(panel, true, count * 2);
+    panel->stats.data_bytes += count * 2;
+    for (size_t i = 0; i < count; i++) {
+        ILI9341_Sim_Param(panel, pixels[i] >> 8);
+        ILI9341_Sim_Param(panel, pixels[i] & 0xFF);
+    }
+}
+
+/**
+ * @brief Write native order pixels to the simulated panel, transfers complete immediately
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_WritePixelDataAsync(ILI9341_HandleTypeDef* ili9341, const uint16_t* pixels, size_t count) {
+    ILI9341_Sim_WritePixelData(ili9341, pixels, count);
+    if (ili9341->transfer_callback) ili9341->transfer_callback(ili9341, ili9341->transfer_callback_arg);
+}
+
+/**
+ * @brief Transfers of the simulated panel complete immediately, nothing to wait for
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_Wait(ILI9341_HandleTypeDef* ili9341) {
+    (void)ili9341;
+}
+
+/**
+ * @brief Write the same pixel color multiple times to the simulated panel
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_WritePixels(ILI9341_HandleTypeDef* ili9341, uint16_t color, uint32_t count) {
+    ILI9341_Sim_PanelTypeDef* panel = ili9341->transport_ctx;
+    ILI9341_Sim_Access(panel, true, count * 2);
+    panel->stats.data_bytes += count * 2;
+    for (uint32_t i = 0; i < count; i++) {
+        ILI9341_Sim_Param(panel, color >> 8);
+        ILI9341_Sim_Param(panel, color & 0xFF);
+    }
+}
+
+/**
+ * @brief Read data bytes from the simulated panel
+ * @param ili9341 Pointer to ILI9341 handle structure
+ */
+static void ILI9341_Sim_ReadData(ILI9341_HandleTypeDef* ili9341, uint8_t* buff, size_t buff_size) {
+    ILI9341_Sim_PanelTypeDef* panel = ili9341->transport_ctx;
+    ILI9341_Sim_Access(panel, true, buff_size);
+    panel->stats.read_bytes += buff_size;
+    for (size_t i = 0; i < buff_size; i++) { buff[i] = ILI9341_Sim_ReadByte(panel); }
+}
+
+static const ILI9341_TransportTypeDef ILI9341_Sim_Transport = {
+    .select = ILI9341_Sim_Select,
+    .deselect = ILI9341_Sim_Deselect,
+    .reset = ILI9341_Sim_Reset,
+    .delay = ILI9341_Sim_Delay,
+    .write_command = ILI9341_Sim_WriteCommand,
+    .write_data = ILI9341_Sim_WriteData,
+    .write_pixel_data = ILI9341_Sim_WritePixelData,
+    .write_pixel_data_async = ILI9341_Sim_WritePixelDataAsync,
+    .wait = ILI9341_Sim_Wait,
+    .write_pixels = ILI9341_Sim_WritePixels,
+    .read_data = ILI9341_Sim_ReadData
+};
+
+ILI9341_HandleTypeDef ILI9341_Sim_Init(
+    ILI9341_Sim_PanelTypeDef* panel,
+    uint8_t rotation,
+    uint16_t width,
+    uint16_t height
+) {
+    memset(panel, 0, sizeof(*panel));
+    ILI9341_Sim_ResetController(panel);
+
+    ILI9341_HandleTypeDef ili9341_instance = {
+        .transport = &ILI9341_Sim_Transport,
+        .transport_ctx = panel,
+        .rotation = rotation,
+        .width = width,
+        .height = height
+    };
+
+    ILI9341_InitDisplay(&ili9341_instance);
+    ILI9341_Sim_ResetStats(panel);
+
+    return ili9341_instance;
+}
+
+void ILI9341_Sim_ResetStats(ILI9341_Sim_PanelTypeDef* panel) {
+    memset(&panel->stats, 0, sizeof(panel->stats));
+}
+
+uint16_t ILI9341_Sim_ReadPixel(ILI9341_Sim_PanelTypeDef* panel, uint16_t x, uint16_t y) {
+    uint16_t* cell = ILI9341_Sim_Cell(panel, x, y);
+    return cell ? *cell : 0;
+}
+
+void ILI9341_Sim_Snapshot(ILI9341_Sim_PanelTypeDef* panel, uint16_t* frame) {
+    uint16_t tfa = panel->top_fixed_lines;
+    uint16_t vsa = panel->scroll_lines;
+    bool scroll_valid = vsa > 0 && tfa + vsa + panel->bottom_fixed_lines == ILI9341_SIM_GRAM_HEIGHT &&
+                        panel->scroll_start >= tfa && panel->scroll_start < tfa + vsa;
+
+    for (uint16_t line = 0; line < ILI9341_SIM_GRAM_HEIGHT; line++) {
+        uint16_t source = line;
+        if (scroll_valid && line >= tfa && line < tfa + vsa) {
+            source = tfa + (panel->scroll_start - tfa + line - tfa) % vsa;
+        }
+
+        // the glass of the common ILI9341 modules shows GRAM column 0 at its right edge
+        for (uint16_t col = 0; col < ILI9341_SIM_GRAM_WIDTH; col++) {
+            uint16_t color = panel->display_on ? panel->gram[source][ILI9341_SIM_GRAM_WIDTH - 1 - col] : 0;
+            if (panel->inverted) color = ~color;
+            frame[line * ILI9341_SIM_GRAM_WIDTH + col] = color;
+        }
+    }
+}
+
+bool ILI9341_Sim_SavePPM(ILI9341_Sim_PanelTypeDef* panel, const char* path) {
+    static uint16_t frame[ILI9341_SIM_GRAM_WIDTH * ILI9341_SIM_GRAM_HEIGHT];
+    ILI9341_Sim_Snapshot(panel, frame);
+
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+
+    fprintf(file, "P6\n%d %d\n255\n", ILI9341_SIM_GRAM_WIDTH, ILI9341_SIM_GRAM_HEIGHT);
+    for (uint32_t i = 0; i < ILI9341_SIM_GRAM_WIDTH * ILI9341_SIM_GRAM_HEIGHT; i++) {
+        uint16_t color = frame[i];
+        uint8_t rgb[] = {
+            (color >> 8 & 0xF8) | (color >> 13),
+            (color >> 3 & 0xFC) | (color >> 9 & 0x03),
+            (color << 3 & 0xF8) | (color >> 2 & 0x07)
+        };
+        fwrite(rgb, sizeof(rgb), 1, file);
+    }
+
+    return fclose(file) == 0;
+}
+
+uint64_t ILI9341_Sim_BusTimeNs(const ILI9341_Sim_StatsTypeDef* stats, uint32_t spi_hz) {
+    uint64_t bits = ((uint64_t)stats->commands + stats->data_bytes + stats->read_bytes) * 8;
+    return bits * 1000000000ULL / spi_hz;
+}
@@ -0,0 +1,174 @@
+/* vim: set ai et ts=4 sw=4: */
+#include "ili9341_trace.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// the handle only has a trace pointer when the driver is built with tracing
+#ifdef ILI9341_TRACE
+
+/**
+ * @brief Take the next event of the ring buffer, overwriting the oldest one when it is full
+ * @param trace Pointer to the trace
+ * @return Pointer to the event to fill
+ */
+static ILI9341_TraceEventTypeDef* ILI9341_TraceNext(ILI9341_TraceTypeDef* trace) {
+    ILI9341_TraceEventTypeDef* event = &trace->events[trace->head];
+    trace->head = trace->head + 1 < trace->capacity ? trace->head + 1 : 0;
+    if (trace->count < trace->capacity) {
+        trace->count++;
+    } else {
+        trace->dropped++;
+    }
+    return event;
+}
+
+/**
+ * @brief Get a stored event, oldest first
+ * @param trace Pointer to the trace
+ * @param index Index of the event, from 0 to count - 1
+ * @return Pointer to the event
+ */
+static const ILI9341_TraceEventTypeDef* ILI9341_TraceAt(const ILI9341_TraceTypeDef* trace, uint32_t index) {
+    uint32_t oldest = trace->head + trace->capacity - trace->count;
+    return &trace->events[(oldest + index) % trace->capacity];
+}
+
+/**
+ * @brief Store a 32-bit value little endian
+ * @param buff Pointer to the 4 output bytes
+ * @param value Value to store
+ */
+static void ILI9341_TracePut32(uint8_t* buff, uint32_t value) {
+    buff[0] = value & 0xFF;
+    buff[1] = (value >> 8) & 0xFF;
+    buff[2] = (value >> 16) & 0xFF;
+    buff[3] = value >> 24;
+}
+
+void ILI9341_AttachTrace(
+    ILI9341_HandleTypeDef* ili9341,
+    ILI9341_TraceTypeDef* trace,
+    ILI9341_TraceEventTypeDef* events,
+    uint32_t capacity
+) {
+    ILI9341_Wait(ili9341);
+
+    if (trace) {
+        trace->events = events;
+        trace->capacity = capacity;
+        trace->timestamp_hz = ILI9341_TRACE_TIMESTAMP_HZ();
+        trace->command = 0;
+        trace->paused = capacity == 0;
+        ILI9341_TraceClear(trace);
+    }
+
+    ili9341->trace = trace;
+}
+
+void ILI9341_TraceClear(ILI9341_TraceTypeDef* trace) {
+    trace->head = 0;
+    trace->count = 0;
+    trace->dropped = 0;
+}
+
+void ILI9341_TraceRecord(ILI9341_TraceTypeDef* trace, uint8_t type, const uint8_t* data, uint32_t length) {
+    if (trace->paused) return;
+
+    if (type == ILI9341_TRACE_COMMAND) trace->command = data[0];
+
+    ILI9341_TraceEventTypeDef* event = ILI9341_TraceNext(trace);
+    event->timestamp = ILI9341_TRACE_TIMESTAMP();
+    event->length = length;
+    event->type = type;
+    event->command = trace->command;
+    event->data_length = 0;
+
+    if (data) {
+        // a fill is one color repeated, other operations keep their first bytes
+        uint32_t data_length = type == ILI9341_TRACE_FILL ? 2 : length;
+        event->data_length = data_length < ILI9341_TRACE_DATA_SIZE ? data_length : ILI9341_TRACE_DATA_SIZE;
+        memcpy(event->data, data, event->data_length);
+    }
+}
+
+void ILI9341_TraceRecordPixels(ILI9341_TraceTypeDef* trace, const uint16_t* pixels, size_t count) {
+    uint8_t data[ILI9341_TRACE_DATA_SIZE];
+    size_t captured = count < ILI9341_TRACE_DATA_SIZE / 2 ? count : ILI9341_TRACE_DATA_SIZE / 2;
+    for (size_t i = 0; i < captured; i++) {
+        data[i * 2] = pixels[i] >> 8;
+        data[i * 2 + 1] = pixels[i] & 0xFF;
+    }
+
+    ILI9341_TraceRecord(trace, ILI9341_TRACE_PIXELS, data, count * 2);
+}
+
+void ILI9341_TraceMarkFrame(ILI9341_HandleTypeDef* ili9341) {
+    if (ili9341->trace) ILI9341_TraceRecord(ili9341->trace, ILI9341_TRACE_FRAME, NULL, 0);
+}
+
+bool ILI9341_TraceExportBinary(const ILI9341_TraceTypeDef* trace, ILI9341_TraceWriteFunc write, void* arg) {
+    uint8_t buff[ILI9341_TRACE_EVENT_SIZE];
+
+    memcpy(buff, ILI9341_TRACE_MAGIC, 4);
+    buff[4] = ILI9341_TRACE_VERSION & 0xFF;
+    buff[5] = ILI9341_TRACE_VERSION >> 8;
+    buff[6] = ILI9341_TRACE_EVENT_SIZE & 0xFF;
+    buff[7] = ILI9341_TRACE_EVENT_SIZE >> 8;
+    ILI9341_TracePut32(buff + 8, trace->count);
+    ILI9341_TracePut32(buff + 12, trace->timestamp_hz);
+    if (!write(buff, ILI9341_TRACE_HEADER_SIZE, arg)) return false;
+
+    for (uint32_t i = 0; i < trace->count; i++) {
+        const ILI9341_TraceEventTypeDef* event = ILI9341_TraceAt(trace, i);
+        ILI9341_TracePut32(buff, event->timestamp);
+        ILI9341_TracePut32(buff + 4, event->length);
+        buff[8] = event->type;
+        buff[9] = event->command;
+        buff[10] = event->data_length;
+        buff[11] = 0;
+        memset(buff + 12, 0, ILI9341_TRACE_DATA_SIZE);
+        memcpy(buff + 12, event->data, event->data_length);
+        if (!write(buff, ILI9341_TRACE_EVENT_SIZE, arg)) return false;
+    }
+
+    return true;
+}
+
+bool ILI9341_TraceExportCSV(const ILI9341_TraceTypeDef* trace, ILI9341_TraceWriteFunc write, void* arg) {
+    static const char* const names[] = {
+        "select", "deselect", "reset", "command", "data", "pixels", "fill", "frame", "read"
+    };
+    char line[96];
+
+    int size = snprintf(line, sizeof(line), "timestamp,event,dc,command,length,data\r\n");
+    if (!write(line, size, arg)) return false;
+
+    for (uint32_t i = 0; i < trace->count; i++) {
+        const ILI9341_TraceEventTypeDef* event = ILI9341_TraceAt(trace, i);
+        bool has_dc = (event->type >= ILI9341_TRACE_COMMAND && event->type <= ILI9341_TRACE_FILL) ||
+                      event->type == ILI9341_TRACE_READ;
+
+        size = snprintf(
+            line,
+            sizeof(line),
+            "%lu,%s,%s,0x%02X,%lu,",
+            (unsigned long)event->timestamp,
+            event->type < sizeof(names) / sizeof(names[0]) ? names[event->type] : "unknown",
+            has_dc ? (event->type == ILI9341_TRACE_COMMAND ? "0" : "1") : "",
+            event->command,
+            (unsigned long)event->length
+        );
+        for (uint8_t j = 0; j < event->data_length; j++) {
+            size += snprintf(line + size, sizeof(line) - size, "%02X", event->data[j]);
+        }
+        size += snprintf(line + size, sizeof(line) - size, "\r\n");
+        if (!write(line, size, arg)) return false;
+    }
+
+    return true;
+}
+
+#endif  // ILI9341_TRACE
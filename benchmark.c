@@ -0,0 +1,361 @@
+/**
+ * @file    benchmark.c
+ * @brief   ILI9341 benchmark file
+ * @note    This file measures the bus traffic and time of the drawing functions on the target. Results are printed with
+ *          printf, retarget it to a UART or SWO. Set BENCHMARK_SPI_HZ to the SPI clock of the display bus.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "ili9341.h"
+#include "ili9341_fonts.h"
+
+#ifndef BENCHMARK_SPI_HZ
+#define BENCHMARK_SPI_HZ 50000000
+#endif
+
+#define BENCHMARK_REPEAT 10
+#define BENCHMARK_POLYGON_VERTICES 1000
+#define BENCHMARK_GLYPH_CACHE_SIZE (16 * (16 * 32 * 2 + 16))  // 16 glyphs up to 16x32
+
+// build with and without ILI9341_FAST_IO / ILI9341_ENABLE_DMA to compare the transports
+#ifdef ILI9341_ENABLE_DMA
+#define BENCHMARK_DMA "on"
+#else
+#define BENCHMARK_DMA "off"
+#endif
+
+#ifdef ILI9341_FAST_IO
+#define BENCHMARK_FAST_IO "on"
+#else
+#define BENCHMARK_FAST_IO "off"
+#endif
+
+typedef struct {
+    const char* name;
+    void (*run)(ILI9341_HandleTypeDef* ili9341, uint16_t size);
+    uint16_t size;        // size passed to run, e.g. the radius of circles
+    uint32_t operations;  // drawing calls made by one run, for the cycles per call column
+} BenchmarkCase;
+
+static void benchmarkFillScreen(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    (void)size;
+    ILI9341_FillScreen(ili9341, ILI9341_COLOR_BLUE);
+}
+
+static void benchmarkFillRectangleSmall(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    (void)size;
+    ILI9341_FillRectangle(ili9341, 10, 10, 16, 16, ILI9341_COLOR_RED);
+}
+
+static void benchmarkFillRectangleLarge(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    (void)size;
+    ILI9341_FillRectangle(ili9341, 20, 20, 280, 200, ILI9341_COLOR_GREEN);
+}
+
+// every pixel is on a new row and column, each call sets a full address window (CASET, RASET, RAMWR)
+static void benchmarkSetAddressWindow(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    (void)size;
+    for (uint16_t i = 0; i < 200; i++) {
+        ILI9341_DrawPixel(ili9341, i, i, ILI9341_COLOR_WHITE);
+    }
+}
+
+// consecutive pixels of a row, each call continues the previous memory write (RAMWRC)
+static void benchmarkDrawPixel(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    (void)size;
+    for (uint16_t i = 0; i < 200; i++) {
+        ILI9341_DrawPixel(ili9341, i, 220, ILI9341_COLOR_WHITE);
+    }
+}
+
+static void benchmarkDrawLineShallow(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    (void)size;
+    ILI9341_DrawLine(ili9341, 0, 100, 319, 140, ILI9341_COLOR_WHITE);
+}
+
+static void benchmarkDrawLineDiagonal(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    (void)size;
+    ILI9341_DrawLine(ili9341, 0, 0, 319, 239, ILI9341_COLOR_WHITE);
+}
+
+// mostly off-screen, only the visible part should cost bus time
+static void benchmarkDrawLineClipped(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    (void)size;
+    ILI9341_DrawLine(ili9341, -3000, -2000, 3319, 2239, ILI9341_COLOR_WHITE);
+}
+
+// chart trace of size segments, a triangle wave across the screen
+static void benchmarkChartTrace(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    int16_t step = 320 / size;
+    for (uint16_t i = 0; i < size; i++) {
+        int16_t y1 = 40 + (i % 8 < 4 ? i % 8 : 8 - i % 8) * 40;
+        int16_t y2 = 40 + ((i + 1) % 8 < 4 ? (i + 1) % 8 : 8 - (i + 1) % 8) * 40;
+        ILI9341_DrawLine(ili9341, i * step, y1, (i + 1) * step, y2, ILI9341_COLOR_GREEN);
+    }
+}
+
+// the same trace 5 pixels thick, one rounded line per segment against a single stroke of the whole trace
+static void benchmarkChartTraceThick(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    int16_t step = 320 / size;
+    for (uint16_t i = 0; i < size; i++) {
+        int16_t y1 = 40 + (i % 8 < 4 ? i % 8 : 8 - i % 8) * 40;
+        int16_t y2 = 40 + ((i + 1) % 8 < 4 ? (i + 1) % 8 : 8 - (i + 1) % 8) * 40;
+        ILI9341_DrawLineThick(ili9341, i * step, y1, (i + 1) * step, y2, ILI9341_COLOR_GREEN, 5, true);
+    }
+}
+
+// the same trace anti-aliased, 1 pixel wide against the black background
+static void benchmarkChartTraceAA(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    int16_t step = 320 / size;
+    for (uint16_t i = 0; i < size; i++) {
+        int16_t y1 = 40 + (i % 8 < 4 ? i % 8 : 8 - i % 8) * 40;
+        int16_t y2 = 40 + ((i + 1) % 8 < 4 ? (i + 1) % 8 : 8 - (i + 1) % 8) * 40;
+        ILI9341_DrawLineAA(ili9341, i * step, y1, (i + 1) * step, y2, ILI9341_COLOR_GREEN, ILI9341_COLOR_BLACK);
+    }
+}
+
+static uint32_t benchmarkStrokeScratch[(ILI9341_STROKE_SCRATCH_SIZE(65) + 3) / 4];
+
+static void benchmarkChartStroke(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    int16_t x[65];
+    int16_t y[65];
+    int16_t step = 320 / size;
+    for (uint16_t i = 0; i <= size; i++) {
+        x[i] = i * step;
+        y[i] = 40 + (i % 8 < 4 ? i % 8 : 8 - i % 8) * 40;
+    }
+
+    ILI9341_DrawPolylineThick(
+        ili9341,
+        x,
+        y,
+        size + 1,
+        ILI9341_COLOR_GREEN,
+        5,
+        ILI9341_JOIN_ROUND,
+        false,
+        benchmarkStrokeScratch,
+        sizeof(benchmarkStrokeScratch)
+    );
+}
+
+static void benchmarkDrawCircle(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    ILI9341_DrawCircle(ili9341, 160, 120, size, ILI9341_COLOR_YELLOW);
+}
+
+static void benchmarkDrawCircleAA(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    ILI9341_DrawCircleAA(ili9341, 160, 120, size, ILI9341_COLOR_YELLOW, ILI9341_COLOR_BLACK);
+}
+
+static void benchmarkDrawCircleThick(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    ILI9341_DrawCircleThick(ili9341, 160, 120, size, ILI9341_COLOR_CYAN, size / 4 + 2);
+}
+
+static void benchmarkFillCircle(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    ILI9341_FillCircle(ili9341, 160, 120, size, ILI9341_COLOR_MAGENTA);
+}
+
+static int16_t benchmarkPolygonX[BENCHMARK_POLYGON_VERTICES];
+static int16_t benchmarkPolygonY[BENCHMARK_POLYGON_VERTICES];
+static uint16_t benchmarkPolygonVertices;
+static uint32_t benchmarkPolygonScratch[(ILI9341_POLYGON_SCRATCH_SIZE(BENCHMARK_POLYGON_VERTICES) + 3) / 4];
+
+// star of size vertices alternating between two radii, built before the first run so only the fill is measured
+static void benchmarkFillPolygon(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    if (benchmarkPolygonVertices != size) {
+        for (uint16_t i = 0; i < size; i++) {
+            float angle = 6.2831853f * i / size;
+            float radius = i % 2 ? 50.0f : 115.0f;
+            benchmarkPolygonX[i] = (int16_t)(160.0f + radius * cosf(angle));
+            benchmarkPolygonY[i] = (int16_t)(120.0f + radius * sinf(angle));
+        }
+        benchmarkPolygonVertices = size;
+    }
+
+    ILI9341_FillPolygonWithRule(
+        ili9341,
+        benchmarkPolygonX,
+        benchmarkPolygonY,
+        size,
+        ILI9341_COLOR_GREEN,
+        ILI9341_FILL_RULE_EVEN_ODD,
+        benchmarkPolygonScratch,
+        sizeof(benchmarkPolygonScratch)
+    );
+}
+
+static ILI9341_FontDef* const benchmarkFonts[] = {
+    &ILI9341_Font_Spleen5x8,
+    &ILI9341_Font_Spleen6x12,
+    &ILI9341_Font_Spleen8x16,
+    &ILI9341_Font_Spleen12x24,
+    &ILI9341_Font_Spleen16x32,
+    &ILI9341_Font_Spleen32x64,
+    &ILI9341_Font_Terminus6x12b,
+    &ILI9341_Font_Terminus6x12,
+    &ILI9341_Font_Terminus8x14b,
+    &ILI9341_Font_Terminus8x14,
+    &ILI9341_Font_Terminus8x16b,
+    &ILI9341_Font_Terminus8x16,
+    &ILI9341_Font_Terminus10x18b,
+    &ILI9341_Font_Terminus10x18,
+    &ILI9341_Font_Terminus10x20b,
+    &ILI9341_Font_Terminus10x20,
+    &ILI9341_Font_Terminus11x22b,
+    &ILI9341_Font_Terminus11x22,
+    &ILI9341_Font_Terminus12x24b,
+    &ILI9341_Font_Terminus12x24,
+    &ILI9341_Font_Terminus14x28b,
+    &ILI9341_Font_Terminus14x28,
+    &ILI9341_Font_Terminus16x32b,
+    &ILI9341_Font_Terminus16x32,
+};
+
+// 10 characters of the font given by its index in benchmarkFonts, one window for the line
+static void benchmarkWriteString(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    ILI9341_WriteString(
+        ili9341,
+        0,
+        100,
+        "Temp 21.5C",
+        *benchmarkFonts[size],
+        ILI9341_COLOR_WHITE,
+        ILI9341_COLOR_BLACK,
+        0
+    );
+}
+
+// the same text drawn from a glyph cache, the first run fills the cache and the following ones copy from it
+static void benchmarkWriteStringCached(ILI9341_HandleTypeDef* ili9341, uint16_t size) {
+    static ILI9341_GlyphCacheTypeDef cache;
+    static uint8_t arena[BENCHMARK_GLYPH_CACHE_SIZE];
+    if (cache.capacity == 0) ILI9341_AttachGlyphCache(ili9341, &cache, arena, sizeof(arena), 16 * 32);
+
+    // attached for this case only, the content is kept between the runs
+    ili9341->glyph_cache = &cache;
+    benchmarkWriteString(ili9341, size);
+    ili9341->glyph_cache = NULL;
+}
+
+static const BenchmarkCase benchmarkCases[] = {
+    {"FillScreen", benchmarkFillScreen, 0, 1},
+    {"FillRectangle 16x16", benchmarkFillRectangleSmall, 0, 1},
+    {"FillRectangle 280x200", benchmarkFillRectangleLarge, 0, 1},
+    {"SetAddressWindow", benchmarkSetAddressWindow, 0, 200},
+    {"DrawPixel", benchmarkDrawPixel, 0, 200},
+    {"DrawLine shallow", benchmarkDrawLineShallow, 0, 1},
+    {"DrawLine diagonal", benchmarkDrawLineDiagonal, 0, 1},
+    {"DrawLine clipped", benchmarkDrawLineClipped, 0, 1},
+    {"Chart trace 16", benchmarkChartTrace, 16, 16},
+    {"Chart trace 64", benchmarkChartTrace, 64, 64},
+    {"Chart trace thick 16", benchmarkChartTraceThick, 16, 16},
+    {"Chart trace thick 64", benchmarkChartTraceThick, 64, 64},
+    {"Chart trace AA 16", benchmarkChartTraceAA, 16, 16},
+    {"Chart trace AA 64", benchmarkChartTraceAA, 64, 64},
+    {"Chart stroke 16", benchmarkChartStroke, 16, 1},
+    {"Chart stroke 64", benchmarkChartStroke, 64, 1},
+    {"DrawCircle r=5", benchmarkDrawCircle, 5, 1},
+    {"DrawCircle r=20", benchmarkDrawCircle, 20, 1},
+    {"DrawCircle r=60", benchmarkDrawCircle, 60, 1},
+    {"DrawCircle r=119", benchmarkDrawCircle, 119, 1},
+    {"DrawCircleAA r=20", benchmarkDrawCircleAA, 20, 1},
+    {"DrawCircleAA r=119", benchmarkDrawCircleAA, 119, 1},
+    {"DrawCircleThick r=20", benchmarkDrawCircleThick, 20, 1},
+    {"DrawCircleThick r=60", benchmarkDrawCircleThick, 60, 1},
+    {"DrawCircleThick r=119", benchmarkDrawCircleThick, 119, 1},
+    {"FillCircle r=5", benchmarkFillCircle, 5, 1},
+    {"FillCircle r=20", benchmarkFillCircle, 20, 1},
+    {"FillCircle r=60", benchmarkFillCircle, 60, 1},
+    {"FillCircle r=119", benchmarkFillCircle, 119, 1},
+    {"FillPolygon n=100", benchmarkFillPolygon, 100, 1},
+    {"FillPolygon n=250", benchmarkFillPolygon, 250, 1},
+    {"FillPolygon n=500", benchmarkFillPolygon, 500, 1},
+    {"FillPolygon n=1000", benchmarkFillPolygon, 1000, 1},
+    {"Text Spleen5x8", benchmarkWriteString, 0, 1},
+    {"Text Spleen6x12", benchmarkWriteString, 1, 1},
+    {"Text Spleen8x16", benchmarkWriteString, 2, 1},
+    {"Text Spleen12x24", benchmarkWriteString, 3, 1},
+    {"Text Spleen16x32", benchmarkWriteString, 4, 1},
+    {"Text Spleen32x64", benchmarkWriteString, 5, 1},
+    {"Text Terminus6x12b", benchmarkWriteString, 6, 1},
+    {"Text Terminus6x12", benchmarkWriteString, 7, 1},
+    {"Text Terminus8x14b", benchmarkWriteString, 8, 1},
+    {"Text Terminus8x14", benchmarkWriteString, 9, 1},
+    {"Text Terminus8x16b", benchmarkWriteString, 10, 1},
+    {"Text Terminus8x16", benchmarkWriteString, 11, 1},
+    {"Text Terminus10x18b", benchmarkWriteString, 12, 1},
+    {"Text Terminus10x18", benchmarkWriteString, 13, 1},
+    {"Text Terminus10x20b", benchmarkWriteString, 14, 1},
+    {"Text Terminus10x20", benchmarkWriteString, 15, 1},
+    {"Text Terminus11x22b", benchmarkWriteString, 16, 1},
+    {"Text Terminus11x22", benchmarkWriteString, 17, 1},
+    {"Text Terminus12x24b", benchmarkWriteString, 18, 1},
+    {"Text Terminus12x24", benchmarkWriteString, 19, 1},
+    {"Text Terminus14x28b", benchmarkWriteString, 20, 1},
+    {"Text Terminus14x28", benchmarkWriteString, 21, 1},
+    {"Text Terminus16x32b", benchmarkWriteString, 22, 1},
+    {"Text Terminus16x32", benchmarkWriteString, 23, 1},
+    {"Text cached Spleen8x16", benchmarkWriteStringCached, 2, 1},
+    {"Text cached Spleen16x32", benchmarkWriteStringCached, 4, 1},
+};
+
+static void benchmarkRun(ILI9341_HandleTypeDef* ili9341, const BenchmarkCase* benchmarkCase) {
+    ILI9341_Wait(ili9341);
+    ili9341->stats = (ILI9341_StatsTypeDef){0};
+
+    uint32_t start = DWT->CYCCNT;
+    for (uint8_t i = 0; i < BENCHMARK_REPEAT; i++) {
+        benchmarkCase->run(ili9341, benchmarkCase->size);
+    }
+    ILI9341_Wait(ili9341);
+    uint32_t cycles = (DWT->CYCCNT - start) / BENCHMARK_REPEAT;
+
+    uint32_t transfers = ili9341->stats.transfers / BENCHMARK_REPEAT;
+    uint32_t bytes = ili9341->stats.bytes / BENCHMARK_REPEAT;
+    uint32_t busTime = (uint32_t)((uint64_t)bytes * 8 * 1000000 / BENCHMARK_SPI_HZ);
+    uint32_t time = (uint32_t)((uint64_t)cycles * 1000000 / SystemCoreClock);
+
+    printf(
+        "%-24s %8lu transfers %8lu bytes %8lu us bus %8lu us total %8lu cycles/call\r\n",
+        benchmarkCase->name,
+        (unsigned long)transfers,
+        (unsigned long)bytes,
+        (unsigned long)busTime,
+        (unsigned long)time,
+        (unsigned long)(cycles / benchmarkCase->operations)
+    );
+}
+
+int main(void) {
+    ILI9341_HandleTypeDef ili9341 = ILI9341_Init(
+        &hspi5,
+        ILI9341_CS_GPIO_Port,
+        ILI9341_CS_Pin,
+        ILI9341_DC_GPIO_Port,
+        ILI9341_DC_Pin,
+        ILI9341_RST_GPIO_Port,
+        ILI9341_RST_Pin,
+        ILI9341_ROTATION_HORIZONTAL_1,
+        320,
+        240
+    );
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    while (1) {
+        printf(
+            "ILI9341 benchmark, %lu Hz SPI, DMA %s, FAST_IO %s\r\n",
+            (unsigned long)BENCHMARK_SPI_HZ,
+            BENCHMARK_DMA,
+            BENCHMARK_FAST_IO
+        );
+        for (uint8_t i = 0; i < sizeof(benchmarkCases) / sizeof(benchmarkCases[0]); i++) {
+            benchmarkRun(&ili9341, &benchmarkCases[i]);
+        }
+        HAL_Delay(5000);
+    }
+}
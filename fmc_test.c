@@ -0,0 +1,195 @@
+/**
+ * @file    fmc_test.c
+ * @brief   ILI9341 FMC transport test
+ * @note    This host program builds the FMC transport with its bus accesses redirected into a mock memory region and
+ *          checks the command/data stream the driver produces on 8-bit and 16-bit buses. Build and run it with:
+ *
+ *          cc -DILI9341_HOST_BUILD -IInc fmc_test.c Src/ili9341.c Src/ili9341_fonts.c -lm -o fmc_test && ./fmc_test
+ *
+ *          The transport source is included below, after the access macros, it must not be linked a second time.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FMC_TEST_LOG_SIZE 64
+#define FMC_TEST_READ_SIZE 64
+
+typedef struct {
+    bool command;   // written to the command address (D/C low)
+    uint8_t width;  // access width in bytes
+    uint16_t value;
+} FmcTestAccess;
+
+// mock memory region, the command and data addresses of the bus
+static uint16_t fmcTestRegion[2];
+
+static FmcTestAccess fmcTestLog[FMC_TEST_LOG_SIZE];
+static uint32_t fmcTestLogCount;
+static uint16_t fmcTestReads[FMC_TEST_READ_SIZE];
+static uint32_t fmcTestReadCount;
+static uint32_t fmcTestReadNext;
+static uint32_t fmcTestFailures;
+
+static void fmcTestWrite(const volatile void* reg, uint8_t width, uint16_t value) {
+    if (fmcTestLogCount < FMC_TEST_LOG_SIZE) {
+        fmcTestLog[fmcTestLogCount] = (FmcTestAccess){reg == (const volatile void*)&fmcTestRegion[0], width, value};
+    }
+    fmcTestLogCount++;
+}
+
+static uint16_t fmcTestRead(const volatile void* reg, uint8_t width) {
+    if (fmcTestLogCount < FMC_TEST_LOG_SIZE) {
+        fmcTestLog[fmcTestLogCount] = (FmcTestAccess){reg == (const volatile void*)&fmcTestRegion[0], width, 0};
+    }
+    fmcTestLogCount++;
+    return fmcTestReadNext < fmcTestReadCount ? fmcTestReads[fmcTestReadNext++] : 0;
+}
+
+#define ILI9341_FMC_WRITE(reg, value) fmcTestWrite((reg), sizeof(*(reg)), (value))
+#define ILI9341_FMC_READ(reg) fmcTestRead((reg), sizeof(*(reg)))
+#include "Src/ili9341_fmc.c"
+
+// expected accesses, C for the command address, D for the data address
+#define C(value) {true, 0, value}
+#define D(value) {false, 0, value}
+
+static void fmcTestClear(void) {
+    fmcTestLogCount = 0;
+    fmcTestReadCount = 0;
+    fmcTestReadNext = 0;
+}
+
+// compares the log with the expected accesses, all of the given width
+static void fmcTestExpect(const char* name, uint8_t width, const FmcTestAccess* expected, uint32_t count) {
+    bool ok = fmcTestLogCount == count;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        ok = fmcTestLog[i].command == expected[i].command && fmcTestLog[i].width == width &&
+             fmcTestLog[i].value == expected[i].value;
+    }
+    printf("%-40s %s\n", name, ok ? "ok" : "FAIL");
+    if (ok) return;
+
+    fmcTestFailures++;
+    for (uint32_t i = 0; i < fmcTestLogCount && i < FMC_TEST_LOG_SIZE; i++) {
+        printf(
+            "  %c %u 0x%04X\n",
+            fmcTestLog[i].command ? 'C' : 'D',
+            (unsigned)fmcTestLog[i].width,
+            (unsigned)fmcTestLog[i].value
+        );
+    }
+}
+
+static void fmcTestExpectPixels(const char* name, const uint16_t* pixels, const uint16_t* expected, uint32_t count) {
+    // every queued read cycle must have been consumed
+    bool ok = memcmp(pixels, expected, count * sizeof(uint16_t)) == 0 && fmcTestReadNext == fmcTestReadCount;
+    printf("%-40s %s\n", name, ok ? "ok" : "FAIL");
+    if (!ok) fmcTestFailures++;
+}
+
+static ILI9341_HandleTypeDef fmcTestInit(ILI9341_FMC_BusTypeDef* bus, bool bus_16bit) {
+    *bus = (ILI9341_FMC_BusTypeDef){
+        .command = &fmcTestRegion[0],
+        .data = &fmcTestRegion[1],
+        .bus_16bit = bus_16bit
+    };
+    ILI9341_HandleTypeDef ili9341 = ILI9341_FMC_Init(bus, ILI9341_ROTATION_HORIZONTAL_1, 320, 240);
+    fmcTestClear();
+    return ili9341;
+}
+
+static void fmcTestBus16(void) {
+    ILI9341_FMC_BusTypeDef bus;
+    ILI9341_HandleTypeDef ili9341 = fmcTestInit(&bus, true);
+
+    // parameters are one byte per write, fill pixels one write each
+    ILI9341_FillRectangle(&ili9341, 10, 20, 2, 2, 0xF81F);
+    const FmcTestAccess fill[] = {
+        C(0x2A), D(0x00), D(10), D(0x00), D(11),
+        C(0x2B), D(0x00), D(20), D(0x00), D(21),
+        C(0x2C), D(0xF81F), D(0xF81F), D(0xF81F), D(0xF81F)
+    };
+    fmcTestExpect("16-bit CASET/RASET/RAMWR fill", 2, fill, sizeof(fill) / sizeof(fill[0]));
+
+    // pixel bytes are paired into one write per pixel, also across calls
+    fmcTestClear();
+    const uint8_t first[] = {0x12};
+    const uint8_t second[] = {0x34, 0x56, 0x78};
+    const uint16_t pixel = 0xABCD;
+    ili9341.transport->write_command(&ili9341, 0x2C);
+    ili9341.transport->write_data(&ili9341, first, sizeof(first));
+    ili9341.transport->write_data(&ili9341, second, sizeof(second));
+    ili9341.transport->write_pixel_data(&ili9341, &pixel, 1);
+    const FmcTestAccess pairs[] = {C(0x2C), D(0x1234), D(0x5678), D(0xABCD)};
+    fmcTestExpect("16-bit pixel byte pairing", 2, pairs, sizeof(pairs) / sizeof(pairs[0]));
+
+    // a dummy cycle, then 2 color components per read cycle
+    fmcTestClear();
+    const uint16_t reads[] = {0x00AA, 0xF800, 0xF800, 0xFC00};
+    memcpy(fmcTestReads, reads, sizeof(reads));
+    fmcTestReadCount = sizeof(reads) / sizeof(reads[0]);
+    uint16_t pixels[2];
+    ILI9341_ReadRect(&ili9341, 0, 0, 2, 1, pixels);
+    const uint16_t expected[] = {0xF81F, 0x07E0};
+    fmcTestExpectPixels("16-bit RAMRD unpacking", pixels, expected, 2);
+
+    // components of a read cycle split between two chunks of the driver
+    fmcTestClear();
+    uint16_t many[33];
+    uint16_t many_expected[33];
+    uint8_t components[33 * 3];
+    for (uint32_t i = 0; i < 33; i++) {
+        many_expected[i] = ILI9341_COLOR565(i * 8, (255 - i * 4), i * 2);
+        components[i * 3] = many_expected[i] >> 8 & 0xF8;
+        components[i * 3 + 1] = many_expected[i] >> 3 & 0xFC;
+        components[i * 3 + 2] = many_expected[i] << 3 & 0xF8;
+    }
+    fmcTestReads[0] = 0x00AA;
+    for (uint32_t i = 0; i < sizeof(components) / 2 + 1; i++) {
+        fmcTestReads[1 + i] = components[i * 2] << 8 | (i * 2 + 1 < sizeof(components) ? components[i * 2 + 1] : 0);
+    }
+    fmcTestReadCount = 1 + (sizeof(components) + 1) / 2;
+    ILI9341_ReadRect(&ili9341, 0, 0, 33, 1, many);
+    fmcTestExpectPixels("16-bit RAMRD across chunks", many, many_expected, 33);
+}
+
+static void fmcTestBus8(void) {
+    ILI9341_FMC_BusTypeDef bus;
+    ILI9341_HandleTypeDef ili9341 = fmcTestInit(&bus, false);
+
+    // every access is a byte, pixels are split most significant byte first
+    ILI9341_FillRectangle(&ili9341, 10, 20, 2, 2, 0xF81F);
+    const FmcTestAccess fill[] = {
+        C(0x2A), D(0x00), D(10), D(0x00), D(11),
+        C(0x2B), D(0x00), D(20), D(0x00), D(21),
+        C(0x2C), D(0xF8), D(0x1F), D(0xF8), D(0x1F), D(0xF8), D(0x1F), D(0xF8), D(0x1F)
+    };
+    fmcTestExpect("8-bit CASET/RASET/RAMWR fill", 1, fill, sizeof(fill) / sizeof(fill[0]));
+
+    fmcTestClear();
+    const uint16_t pixel = 0xABCD;
+    ili9341.transport->write_command(&ili9341, 0x2C);
+    ili9341.transport->write_pixel_data(&ili9341, &pixel, 1);
+    const FmcTestAccess split[] = {C(0x2C), D(0xAB), D(0xCD)};
+    fmcTestExpect("8-bit pixel byte splitting", 1, split, sizeof(split) / sizeof(split[0]));
+
+    fmcTestClear();
+    const uint16_t reads[] = {0xAA, 0xF8, 0x00, 0xF8, 0x00, 0xFC, 0x00};
+    memcpy(fmcTestReads, reads, sizeof(reads));
+    fmcTestReadCount = sizeof(reads) / sizeof(reads[0]);
+    uint16_t pixels[2];
+    ILI9341_ReadRect(&ili9341, 0, 0, 2, 1, pixels);
+    const uint16_t expected[] = {0xF81F, 0x07E0};
+    fmcTestExpectPixels("8-bit RAMRD", pixels, expected, 2);
+}
+
+int main(void) {
+    fmcTestBus16();
+    fmcTestBus8();
+
+    printf("%lu failures\n", (unsigned long)fmcTestFailures);
+    return fmcTestFailures ? 1 : 0;
+}
@@ -3,11 +3,17 @@ import sys
 
 
 def main() -> None:
-    if len(sys.argv) != 2:
-        print("Usage: python image_to_array.py <image_file>")
+    args = sys.argv[1:]
+    swap = "--swap" in args
+    if swap:
+        args.remove("--swap")
+
+    if len(args) != 1:
+        print("Usage: python image_to_array.py [--swap] <image_file>")
+        print("  --swap  swap the 2 bytes of each pixel, for firmware built with ILI9341_SWAPPED_IMAGES")
         sys.exit(1)
 
-    image_file_path = sys.argv[1]
+    image_file_path = args[0]
     img = Image.open(image_file_path).convert("RGB")
     colors: list[tuple[int, int, int]] = list(img.getdata())
 
@@ -15,8 +21,8 @@ def main() -> None:
 
     for color in colors:
         color = ((color[0] & 0b11111000) << 8) | ((color[1] & 0b11111100) << 3) | (color[2] >> 3)
-        # swap bytes
-        color = ((color & 0xFF) << 8) | ((color >> 8) & 0xFF)
+        if swap:
+            color = ((color & 0xFF) << 8) | ((color >> 8) & 0xFF)
         int_array.append(color)
 
     with open("image.c", "w") as outFile:
@@ -0,0 +1,94 @@
+import struct
+import sys
+import zlib
+
+MAGIC = b"I9SC"
+VERSION = 1
+HEADER_SIZE = 12
+CHUNK_HEADER_SIZE = 4
+
+
+def read_screenshot(stream: bytes) -> tuple[int, int, bytearray]:
+    # the stream may follow other output of the firmware on the same UART
+    start = stream.find(MAGIC)
+    if start < 0:
+        raise ValueError("no screenshot found")
+
+    version, width, height = struct.unpack_from("<HHH", stream, start + 4)
+    if version != VERSION:
+        raise ValueError(f"unsupported screenshot version {version}")
+
+    rgb = bytearray(width * height * 3)
+    offset = start + HEADER_SIZE
+    y = 0
+    while y < height:
+        if offset + CHUNK_HEADER_SIZE > len(stream):
+            raise ValueError(f"truncated after {y} rows")
+        first, rows = struct.unpack_from("<HH", stream, offset)
+        offset += CHUNK_HEADER_SIZE
+        if first != y or rows == 0 or first + rows > height:
+            raise ValueError(f"unexpected chunk of {rows} rows at row {first}, expected row {y}")
+
+        size = width * rows * 2
+        if offset + size > len(stream):
+            raise ValueError(f"truncated after {y} rows")
+        pixels = struct.unpack_from(f"<{width * rows}H", stream, offset)
+        offset += size
+
+        out = y * width * 3
+        for color in pixels:
+            r = color >> 11
+            g = (color >> 5) & 0x3F
+            b = color & 0x1F
+            rgb[out] = (r << 3) | (r >> 2)
+            rgb[out + 1] = (g << 2) | (g >> 4)
+            rgb[out + 2] = (b << 3) | (b >> 2)
+            out += 3
+        y += rows
+
+    return width, height, rgb
+
+
+def png_chunk(kind: bytes, data: bytes) -> bytes:
+    return struct.pack(">I", len(data)) + kind + data + struct.pack(">I", zlib.crc32(kind + data))
+
+
+def write_png(path: str, width: int, height: int, rgb: bytearray) -> None:
+    stride = width * 3
+    raw = bytearray()
+    for y in range(height):
+        raw.append(0)  # no filter
+        raw += rgb[y * stride:(y + 1) * stride]
+
+    with open(path, "wb") as outFile:
+        outFile.write(b"\x89PNG\r\n\x1a\n")
+        outFile.write(png_chunk(b"IHDR", struct.pack(">IIBBBBB", width, height, 8, 2, 0, 0, 0)))
+        outFile.write(png_chunk(b"IDAT", zlib.compress(bytes(raw), 9)))
+        outFile.write(png_chunk(b"IEND", b""))
+
+
+def main() -> None:
+    args = sys.argv[1:]
+    if len(args) != 2:
+        print("Usage: python screenshot_to_png.py <capture_file|-> <output.png>")
+        print("  capture_file  bytes written by ILI9341_Screenshot (e.g. logged from a UART), - for standard input")
+        sys.exit(1)
+
+    if args[0] == "-":
+        stream = sys.stdin.buffer.read()
+    else:
+        with open(args[0], "rb") as inFile:
+            stream = inFile.read()
+
+    try:
+        width, height, rgb = read_screenshot(stream)
+    except ValueError as error:
+        print(f"{args[0]}: {error}")
+        sys.exit(1)
+
+    write_png(args[1], width, height, rgb)
+    print(f"{width}x{height} screenshot written to {args[1]}")
+
+
+if __name__ == "__main__":
+    main()
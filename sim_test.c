@@ -0,0 +1,301 @@
+/**
+ * @file    sim_test.c
+ * @brief   ILI9341 panel simulator test
+ * @note    This host program checks the command decoding of the panel simulator against the datasheet and the GRAM
+ *          contents and traffic counters of a few drawing functions, then draws the same scene through every
+ *          rendering path of the driver and checks they all produce the same frame. Build and run it with:
+ *
+ *          cc -DILI9341_HOST_BUILD -IInc sim_test.c Src/ili9341.c Src/ili9341_fonts.c Src/ili9341_sim.c -lm \
+ *             -o sim_test && ./sim_test
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ili9341_fonts.h"
+#include "ili9341_sim.h"
+
+#define SIM_TEST_WIDTH 320
+#define SIM_TEST_HEIGHT 240
+
+static ILI9341_Sim_PanelTypeDef simTestPanel;
+static uint16_t simTestReference[ILI9341_SIM_GRAM_HEIGHT][ILI9341_SIM_GRAM_WIDTH];
+static uint16_t simTestFramebuffer[SIM_TEST_WIDTH * SIM_TEST_HEIGHT];
+static uint32_t simTestArena[16 * 1024];
+static uint16_t simTestBuffers[2 * SIM_TEST_WIDTH * 16];
+static uint32_t simTestFailures;
+
+static void simTestCheck(const char* name, bool ok) {
+    printf("%-48s %s\n", name, ok ? "ok" : "FAIL");
+    if (!ok) simTestFailures++;
+}
+
+// the logical area has the given color and the rest of the screen the other one
+static bool simTestArea(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, uint16_t color, uint16_t other) {
+    for (uint16_t y = 0; y < SIM_TEST_HEIGHT; y++) {
+        for (uint16_t x = 0; x < SIM_TEST_WIDTH; x++) {
+            bool inside = x >= x0 && x <= x1 && y >= y0 && y <= y1;
+            if (ILI9341_Sim_ReadPixel(&simTestPanel, x, y) != (inside ? color : other)) return false;
+        }
+    }
+    return true;
+}
+
+static void simTestDecode(void) {
+    ILI9341_HandleTypeDef ili9341 = ILI9341_Sim_Init(
+        &simTestPanel, ILI9341_ROTATION_HORIZONTAL_1, SIM_TEST_WIDTH, SIM_TEST_HEIGHT
+    );
+    const ILI9341_TransportTypeDef* transport = ili9341.transport;
+
+    // a 3x2 window, 4 pixels with RAMWR then 2 with RAMWRC continuing where the first ones stopped
+    const uint8_t columns[] = {0x00, 10, 0x00, 12};
+    const uint8_t pages[] = {0x00, 20, 0x00, 21};
+    const uint16_t first[] = {0x1111, 0x2222, 0x3333, 0x4444};
+    const uint8_t second[] = {0x55, 0x55, 0x66, 0x66};
+    transport->select(&ili9341);
+    transport->write_command(&ili9341, 0x2A);
+    transport->write_data(&ili9341, columns, sizeof(columns));
+    transport->write_command(&ili9341, 0x2B);
+    transport->write_data(&ili9341, pages, sizeof(pages));
+    transport->write_command(&ili9341, 0x2C);
+    transport->write_pixel_data(&ili9341, first, 4);
+    transport->write_command(&ili9341, 0x3C);
+    transport->write_data(&ili9341, second, sizeof(second));
+    transport->deselect(&ili9341);
+
+    const uint16_t expected[2][3] = {{0x1111, 0x2222, 0x3333}, {0x4444, 0x5555, 0x6666}};
+    bool ok = true;
+    for (uint16_t y = 0; y < 2; y++) {
+        for (uint16_t x = 0; x < 3; x++) {
+            ok = ok && ILI9341_Sim_ReadPixel(&simTestPanel, 10 + x, 20 + y) == expected[y][x];
+        }
+    }
+    simTestCheck("CASET/RASET/RAMWR/RAMWRC window", ok);
+    simTestCheck(
+        "CASET/RASET/RAMWR/RAMWRC counters",
+        simTestPanel.stats.commands == 4 && simTestPanel.stats.data_bytes == 8 + 12 && simTestPanel.stats.pixels == 6 &&
+            simTestPanel.stats.selects == 1 && simTestPanel.stats.errors == 0
+    );
+
+    // RAMWR starts over at the top left corner of the window
+    transport->select(&ili9341);
+    transport->write_command(&ili9341, 0x2C);
+    transport->write_pixel_data(&ili9341, &first[3], 1);
+    transport->deselect(&ili9341);
+    simTestCheck("RAMWR restarts at the window origin", ILI9341_Sim_ReadPixel(&simTestPanel, 10, 20) == 0x4444);
+
+    // bytes sent while the panel is not selected are counted as errors
+    transport->write_command(&ili9341, 0x00);
+    simTestCheck("traffic without chip select counted", simTestPanel.stats.errors == 1);
+}
+
+static void simTestRotations(void) {
+    // MADCTL of each rotation and the GRAM cells (native portrait rows and columns) of logical pixels (0, 0) and (1, 0)
+    static const struct {
+        uint8_t rotation;
+        uint16_t width;
+        uint16_t height;
+        uint8_t madctl;
+        uint16_t origin[2];
+        uint16_t next[2];
+    } rotations[] = {
+        {ILI9341_ROTATION_VERTICAL_1, 240, 320, ILI9341_MADCTL_MX | ILI9341_MADCTL_BGR, {0, 239}, {0, 238}},
+        {
+            ILI9341_ROTATION_HORIZONTAL_1, 320, 240,
+            ILI9341_MADCTL_MX | ILI9341_MADCTL_MY | ILI9341_MADCTL_MV | ILI9341_MADCTL_BGR, {319, 239}, {318, 239}
+        },
+        {ILI9341_ROTATION_HORIZONTAL_2, 320, 240, ILI9341_MADCTL_MV | ILI9341_MADCTL_BGR, {0, 0}, {1, 0}},
+        {ILI9341_ROTATION_VERTICAL_2, 240, 320, ILI9341_MADCTL_MY | ILI9341_MADCTL_BGR, {319, 0}, {319, 1}}
+    };
+
+    for (uint8_t i = 0; i < sizeof(rotations) / sizeof(rotations[0]); i++) {
+        ILI9341_HandleTypeDef ili9341 = ILI9341_Sim_Init(
+            &simTestPanel, rotations[i].rotation, rotations[i].width, rotations[i].height
+        );
+        ILI9341_DrawPixel(&ili9341, 0, 0, 0xF800);
+        ILI9341_DrawPixel(&ili9341, 1, 0, 0x07E0);
+
+        char name[48];
+        snprintf(name, sizeof(name), "MADCTL and GRAM mapping of rotation %u", (unsigned)rotations[i].rotation);
+        simTestCheck(
+            name,
+            simTestPanel.madctl == rotations[i].madctl &&
+                simTestPanel.gram[rotations[i].origin[0]][rotations[i].origin[1]] == 0xF800 &&
+                simTestPanel.gram[rotations[i].next[0]][rotations[i].next[1]] == 0x07E0
+        );
+    }
+}
+
+static void simTestReadBack(void) {
+    ILI9341_HandleTypeDef ili9341 = ILI9341_Sim_Init(
+        &simTestPanel, ILI9341_ROTATION_HORIZONTAL_1, SIM_TEST_WIDTH, SIM_TEST_HEIGHT
+    );
+
+    uint16_t image[4 * 3];
+    for (uint16_t i = 0; i < 4 * 3; i++) { image[i] = i * 0x1357 + 0x0841; }
+    ILI9341_DrawImage(&ili9341, 100, 50, 4, 3, image);
+
+    uint16_t pixels[4 * 3] = {0};
+    ILI9341_Sim_ResetStats(&simTestPanel);
+    bool read = ILI9341_ReadRect(&ili9341, 100, 50, 4, 3, pixels);
+    simTestCheck("RAMRD read back", read && memcmp(pixels, image, sizeof(image)) == 0);
+    // a dummy byte, then 3 bytes per pixel
+    simTestCheck("RAMRD read counters", simTestPanel.stats.read_bytes == 1 + 4 * 3 * 3);
+}
+
+static void simTestPrimitives(void) {
+    ILI9341_HandleTypeDef ili9341 = ILI9341_Sim_Init(
+        &simTestPanel, ILI9341_ROTATION_HORIZONTAL_1, SIM_TEST_WIDTH, SIM_TEST_HEIGHT
+    );
+
+    ILI9341_FillScreen(&ili9341, ILI9341_COLOR_BLUE);
+    simTestCheck(
+        "FillScreen GRAM and pixels",
+        simTestArea(0, 0, 0, 0, ILI9341_COLOR_BLUE, ILI9341_COLOR_BLUE) &&
+            simTestPanel.stats.pixels == SIM_TEST_WIDTH * SIM_TEST_HEIGHT
+    );
+
+    // a new window, CASET and RASET with 4 bytes each, then RAMWR and the pixels
+    ILI9341_Sim_ResetStats(&simTestPanel);
+    ILI9341_FillRectangle(&ili9341, 5, 6, 10, 4, ILI9341_COLOR_RED);
+    simTestCheck("FillRectangle GRAM", simTestArea(5, 6, 14, 9, ILI9341_COLOR_RED, ILI9341_COLOR_BLUE));
+    simTestCheck(
+        "FillRectangle counters",
+        simTestPanel.stats.commands == 3 && simTestPanel.stats.data_bytes == 8 + 10 * 4 * 2 &&
+            simTestPanel.stats.pixels == 10 * 4 && simTestPanel.stats.selects == 1
+    );
+
+    // clipped to the screen
+    ILI9341_FillScreen(&ili9341, ILI9341_COLOR_BLUE);
+    ILI9341_Sim_ResetStats(&simTestPanel);
+    ILI9341_FillRectangle(&ili9341, 310, 230, 20, 20, ILI9341_COLOR_RED);
+    simTestCheck(
+        "FillRectangle clipped to the screen",
+        simTestArea(310, 230, 319, 239, ILI9341_COLOR_RED, ILI9341_COLOR_BLUE) && simTestPanel.stats.pixels == 10 * 10
+    );
+
+    ILI9341_FillScreen(&ili9341, ILI9341_COLOR_BLUE);
+    ILI9341_DrawLine(&ili9341, 20, 30, 60, 30, ILI9341_COLOR_WHITE);
+    simTestCheck("DrawLine horizontal", simTestArea(20, 30, 60, 30, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLUE));
+
+    ILI9341_FillScreen(&ili9341, ILI9341_COLOR_BLUE);
+    ILI9341_DrawLine(&ili9341, 40, 10, 40, 50, ILI9341_COLOR_WHITE);
+    simTestCheck("DrawLine vertical", simTestArea(40, 10, 40, 50, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLUE));
+
+    // a pixel is a one pixel window
+    ILI9341_FillScreen(&ili9341, ILI9341_COLOR_BLUE);
+    ILI9341_Sim_ResetStats(&simTestPanel);
+    ILI9341_DrawPixel(&ili9341, 7, 8, ILI9341_COLOR_GREEN);
+    simTestCheck(
+        "DrawPixel",
+        simTestArea(7, 8, 7, 8, ILI9341_COLOR_GREEN, ILI9341_COLOR_BLUE) && simTestPanel.stats.pixels == 1
+    );
+
+    // the diagonal of a square is one pixel per step, the same forwards and backwards
+    ILI9341_FillScreen(&ili9341, ILI9341_COLOR_BLACK);
+    ILI9341_DrawLine(&ili9341, 100, 100, 120, 120, ILI9341_COLOR_WHITE);
+    ILI9341_DrawLine(&ili9341, 120, 120, 100, 100, ILI9341_COLOR_RED);
+    bool diagonal = true;
+    for (uint16_t i = 0; i <= 20; i++) {
+        diagonal = diagonal && ILI9341_Sim_ReadPixel(&simTestPanel, 100 + i, 100 + i) == ILI9341_COLOR_RED;
+        diagonal = diagonal && ILI9341_Sim_ReadPixel(&simTestPanel, 101 + i, 100 + i) == ILI9341_COLOR_BLACK;
+    }
+    simTestCheck("DrawLine diagonal", diagonal);
+}
+
+// scene drawn through every rendering path, opaque text twice to hit the glyph cache
+static void simTestScene(ILI9341_HandleTypeDef* ili9341) {
+    static uint16_t image[16 * 8];
+    for (uint16_t i = 0; i < 16 * 8; i++) { image[i] = i * 0x0209; }
+
+    ILI9341_FillScreen(ili9341, ILI9341_COLOR565(0, 0, 128));
+    ILI9341_FillRectangle(ili9341, 20, 20, 120, 60, ILI9341_COLOR565(0, 100, 0));
+    ILI9341_FillCircle(ili9341, 200, 120, 40, ILI9341_COLOR565(255, 165, 0));
+    ILI9341_DrawLine(ili9341, 0, 239, 319, 0, ILI9341_COLOR_WHITE);
+    ILI9341_DrawRectangle(ili9341, 10, 150, 100, 50, ILI9341_COLOR_YELLOW);
+    ILI9341_DrawImage(ili9341, 250, 200, 16, 8, image);
+    for (uint8_t i = 0; i < 2; i++) {
+        ILI9341_WriteString(
+            ili9341, 30, 100 + i * 20, "Sim 0123", ILI9341_Font_Spleen8x16, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK, 1
+        );
+    }
+}
+
+static ILI9341_HandleTypeDef simTestPathInit(void) {
+    ILI9341_HandleTypeDef ili9341 = ILI9341_Sim_Init(
+        &simTestPanel, ILI9341_ROTATION_HORIZONTAL_1, SIM_TEST_WIDTH, SIM_TEST_HEIGHT
+    );
+    ILI9341_Sim_ResetStats(&simTestPanel);
+    return ili9341;
+}
+
+static void simTestPathCheck(const char* name) {
+    simTestCheck(
+        name,
+        memcmp(simTestPanel.gram, simTestReference, sizeof(simTestReference)) == 0 && simTestPanel.stats.errors == 0
+    );
+}
+
+static void simTestPaths(void) {
+    ILI9341_HandleTypeDef ili9341 = simTestPathInit();
+    simTestScene(&ili9341);
+    memcpy(simTestReference, simTestPanel.gram, sizeof(simTestReference));
+
+    ili9341 = simTestPathInit();
+    ILI9341_AttachPixelBuffers(&ili9341, simTestBuffers, SIM_TEST_WIDTH * 16, 2);
+    simTestScene(&ili9341);
+    simTestPathCheck("pixel buffers draw the same frame");
+
+    ili9341 = simTestPathInit();
+    ILI9341_GlyphCacheTypeDef cache;
+    ILI9341_AttachGlyphCache(&ili9341, &cache, simTestArena, sizeof(simTestArena), 8 * 16);
+    simTestScene(&ili9341);
+    simTestPathCheck("glyph cache draws the same frame");
+    simTestCheck("glyph cache hits the second line", cache.hits > 0);
+
+    ILI9341_DisplayListTypeDef list;
+    ili9341 = simTestPathInit();
+    ILI9341_BeginDisplayList(&ili9341, &list, simTestArena, sizeof(simTestArena));
+    simTestScene(&ili9341);
+    bool recorded = ILI9341_EndDisplayList(&ili9341);
+    ILI9341_ReplayDisplayList(&ili9341, &list, NULL);
+    simTestPathCheck("display list replays the same frame");
+    simTestCheck("display list replays in one chip select cycle", recorded && simTestPanel.stats.selects == 1);
+
+    ili9341 = simTestPathInit();
+    ILI9341_RenderStrips(&ili9341, &list, simTestBuffers, 16, 2, ILI9341_COLOR_BLACK);
+    simTestPathCheck("strips render the same frame");
+
+    // the panel memory starts cleared, like the framebuffer
+    ili9341 = simTestPathInit();
+    ILI9341_FramebufferTypeDef framebuffer;
+    memset(simTestFramebuffer, 0, sizeof(simTestFramebuffer));
+    ILI9341_AttachFramebuffer(&ili9341, &framebuffer, simTestFramebuffer);
+    simTestScene(&ili9341);
+    bool quiet = simTestPanel.stats.selects == 0 && simTestPanel.stats.data_bytes == 0;
+    ILI9341_Flush(&ili9341);
+    simTestPathCheck("framebuffer flushes the same frame");
+    simTestCheck("framebuffer drawing stays off the bus", quiet);
+
+    // widgets redrawn with the same content change no pixel
+    ILI9341_Sim_ResetStats(&simTestPanel);
+    ILI9341_FillRectangle(&ili9341, 20, 20, 120, 60, ILI9341_COLOR565(0, 100, 0));
+    ILI9341_WriteString(
+        &ili9341, 30, 100, "Sim 0123", ILI9341_Font_Spleen8x16, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK, 1
+    );
+    uint32_t sent = ILI9341_Flush(&ili9341);
+    simTestCheck("framebuffer redraw sends nothing", sent == 0 && simTestPanel.stats.selects == 0);
+}
+
+int main(void) {
+    simTestDecode();
+    simTestRotations();
+    simTestReadBack();
+    simTestPrimitives();
+    simTestPaths();
+
+    printf("%lu failures\n", (unsigned long)simTestFailures);
+    return simTestFailures ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file    trace_replay.c
+ * @brief   ILI9341 trace replayer
+ * @note    This host program feeds a binary trace exported with ILI9341_TraceExportBinary into the panel simulator,
+ *          saves an image of the panel at every frame mark and prints the bus time of each frame at the given SPI
+ *          clock. Build it with the simulator:
+ *
+ *          cc -DILI9341_HOST_BUILD -IInc trace_replay.c Src/ili9341.c Src/ili9341_fonts.c Src/ili9341_sim.c -lm \
+ *             -o trace_replay
+ *
+ *          Usage: trace_replay <trace.bin> [spi_hz] [image_prefix]
+ *
+ *          Only the first bytes of each transfer are traced, the pixels that were not captured are replayed in
+ *          magenta so the areas they covered are still visible. Parameters sent before the trace started (MADCTL for
+ *          example) are those of the simulator init sequence.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ili9341_sim.h"
+#include "ili9341_trace.h"
+
+#define REPLAY_DEFAULT_SPI_HZ 50000000
+#define REPLAY_MISSING_COLOR ILI9341_COLOR_MAGENTA
+
+typedef struct {
+    uint32_t events;
+    uint32_t first_timestamp;
+    uint32_t last_timestamp;
+    uint32_t missing_bytes;
+} ReplayFrame;
+
+static uint32_t replayGet32(const uint8_t* buff) {
+    return (uint32_t)buff[0] | (uint32_t)buff[1] << 8 | (uint32_t)buff[2] << 16 | (uint32_t)buff[3] << 24;
+}
+
+// sends the bytes that were not captured, pixels are made up on the missing color
+static void replayMissing(ILI9341_HandleTypeDef* ili9341, uint32_t bytes) {
+    uint8_t color[] = {REPLAY_MISSING_COLOR >> 8, REPLAY_MISSING_COLOR & 0xFF};
+    for (uint32_t i = 0; i < bytes; i++) {
+        ili9341->transport->write_data(ili9341, &color[i & 1], 1);
+    }
+}
+
+static void replayEvent(ILI9341_HandleTypeDef* ili9341, const uint8_t* event, ReplayFrame* frame) {
+    uint32_t length = replayGet32(event + 4);
+    uint8_t type = event[8];
+    uint8_t data_length = event[10];
+    const uint8_t* data = event + 12;
+    if (data_length > ILI9341_TRACE_DATA_SIZE) data_length = ILI9341_TRACE_DATA_SIZE;
+
+    switch (type) {
+        case ILI9341_TRACE_SELECT:
+            ili9341->transport->select(ili9341);
+            break;
+        case ILI9341_TRACE_DESELECT:
+            ili9341->transport->deselect(ili9341);
+            break;
+        case ILI9341_TRACE_RESET:
+            ili9341->transport->reset(ili9341);
+            break;
+        case ILI9341_TRACE_COMMAND:
+            ili9341->transport->write_command(ili9341, data[0]);
+            break;
+        case ILI9341_TRACE_DATA:
+        case ILI9341_TRACE_PIXELS:
+            if (data_length > length) data_length = length;
+            ili9341->transport->write_data(ili9341, data, data_length);
+            replayMissing(ili9341, length - data_length);
+            frame->missing_bytes += length - data_length;
+            break;
+        case ILI9341_TRACE_FILL:
+            ili9341->transport->write_pixels(ili9341, (uint16_t)data[0] << 8 | data[1], length / 2);
+            break;
+        case ILI9341_TRACE_READ: {
+            // the bytes are read again so that the memory pointer of the panel moves on as it did
+            uint8_t buff[64];
+            for (uint32_t i = 0; i < length; i += sizeof(buff)) {
+                ili9341->transport->read_data(ili9341, buff, length - i < sizeof(buff) ? length - i : sizeof(buff));
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void replayReport(
+    ILI9341_Sim_PanelTypeDef* panel,
+    const ReplayFrame* frame,
+    uint32_t index,
+    uint32_t spiHz,
+    uint32_t timestampHz,
+    const char* prefix
+) {
+    uint64_t busTime = ILI9341_Sim_BusTimeNs(&panel->stats, spiHz);
+
+    printf(
+        "frame %4lu: %7lu events %7lu commands %9lu data bytes %9lu missing %9lu us bus",
+        (unsigned long)index,
+        (unsigned long)frame->events,
+        (unsigned long)panel->stats.commands,
+        (unsigned long)panel->stats.data_bytes,
+        (unsigned long)frame->missing_bytes,
+        (unsigned long)(busTime / 1000)
+    );
+    if (timestampHz) {
+        uint64_t ticks = frame->last_timestamp - frame->first_timestamp;
+        printf(" %9lu us traced", (unsigned long)(ticks * 1000000 / timestampHz));
+    }
+    printf("\n");
+
+    if (prefix) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s%04lu.ppm", prefix, (unsigned long)index);
+        if (!ILI9341_Sim_SavePPM(panel, path)) fprintf(stderr, "cannot write %s\n", path);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace.bin> [spi_hz] [image_prefix]\n", argv[0]);
+        return 2;
+    }
+    uint32_t spiHz = argc > 2 ? strtoul(argv[2], NULL, 0) : REPLAY_DEFAULT_SPI_HZ;
+    const char* prefix = argc > 3 ? argv[3] : NULL;
+    if (spiHz == 0) spiHz = REPLAY_DEFAULT_SPI_HZ;
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    uint8_t header[ILI9341_TRACE_HEADER_SIZE];
+    if (fread(header, sizeof(header), 1, file) != 1 || memcmp(header, ILI9341_TRACE_MAGIC, 4) != 0) {
+        fprintf(stderr, "%s: not an ILI9341 trace\n", argv[1]);
+        return 1;
+    }
+    uint16_t version = header[4] | header[5] << 8;
+    uint16_t eventSize = header[6] | header[7] << 8;
+    uint32_t eventCount = replayGet32(header + 8);
+    uint32_t timestampHz = replayGet32(header + 12);
+    if (version != ILI9341_TRACE_VERSION || eventSize < ILI9341_TRACE_EVENT_SIZE) {
+        fprintf(stderr, "%s: unsupported trace version %u\n", argv[1], version);
+        return 1;
+    }
+
+    static ILI9341_Sim_PanelTypeDef panel;
+    ILI9341_HandleTypeDef ili9341 = ILI9341_Sim_Init(&panel, ILI9341_ROTATION_VERTICAL_1, 240, 320);
+
+    ReplayFrame frame = {0};
+    uint32_t frames = 0;
+    uint8_t* event = malloc(eventSize);
+    for (uint32_t i = 0; i < eventCount; i++) {
+        if (fread(event, eventSize, 1, file) != 1) {
+            fprintf(stderr, "%s: truncated after %lu events\n", argv[1], (unsigned long)i);
+            break;
+        }
+
+        uint32_t timestamp = replayGet32(event);
+        if (frame.events == 0) frame.first_timestamp = timestamp;
+        frame.last_timestamp = timestamp;
+        frame.events++;
+
+        if (event[8] == ILI9341_TRACE_FRAME) {
+            replayReport(&panel, &frame, frames++, spiHz, timestampHz, prefix);
+            ILI9341_Sim_ResetStats(&panel);
+            frame = (ReplayFrame){0};
+            continue;
+        }
+        replayEvent(&ili9341, event, &frame);
+    }
+    if (frame.events) replayReport(&panel, &frame, frames, spiHz, timestampHz, prefix);
+
+    free(event);
+    fclose(file);
+    return 0;
+}